@@ -1,13 +1,129 @@
 #include "DS3231.h"
-#include "i2cMaster.h"
+#include "i2cBus.h"
+#include "i2cProfile.h"
+
+#include <stddef.h>
+#include <util/delay.h>
+#include <avr/pgmspace.h>
+
+// the bus the ds3231 is on
+#if DS3231_USE_I2C_MASTER
+static const i2c_bus_t *bus = &i2cMasterBus;
+#else
+static const i2c_bus_t *bus = NULL;
+#endif
+
+// used to track the century
+static uint8_t century = 21; // year 20xx has a century of 21
+// used to indicate the hour storing mode, either AM/PM (12 hour mode) or 24 hour mode
+static bool is24HourMode = true;
+
+#if DS3231_USE_REGISTER_CACHE
+// RAM mirror of every ds3231 register, indexed by register address
+static uint8_t registerCache[DS3231_REGISTER_COUNT];
+static uint32_t registerCacheValid = 0; // bit n set if registerCache[n] holds a known value
+static uint32_t registerDirty = 0; // bit n set if registerCache[n] is waiting to be flushed
+static bool useWriteBack = false;
+#endif
+
+// for every alarm_trigger_t, bit n is set if the nth alarm register (seconds, minutes, hours,
+// day/date) is matched against the time. Unmatched registers get their AxMy mask bit set
+static const uint8_t alarmTriggerMatches[ALARM_TRIGGER_T_MAX] =
+{
+	[A1_EVERY_SEC] = 0,
+	[A1_SEC_MATCH] = 0b0001,
+	[A1_MIN_SEC_MATCH] = 0b0011,
+	[A1_HOUR_MIN_SEC_MATCH] = 0b0111,
+	[A1_DAY_DATE_HOUR_MIN_SEC_MATCH] = 0b1111,
+	[A2_EVERY_MIN] = 0,
+	[A2_MIN_MATCH] = 0b0010,
+	[A2_HOUR_MIN_MATCH] = 0b0110,
+	[A2_DAY_DATE_HOUR_MIN_MATCH] = 0b1110
+};
+
+// the BCD value of every number from 0 to 99, so no division is needed to convert to BCD
+#define BCD_TENS(tens) (tens << 4), (tens << 4) | 1, (tens << 4) | 2, (tens << 4) | 3, (tens << 4) | 4, \
+	(tens << 4) | 5, (tens << 4) | 6, (tens << 4) | 7, (tens << 4) | 8, (tens << 4) | 9
+static const uint8_t bcdValues[100] PROGMEM =
+{
+	BCD_TENS(0), BCD_TENS(1), BCD_TENS(2), BCD_TENS(3), BCD_TENS(4),
+	BCD_TENS(5), BCD_TENS(6), BCD_TENS(7), BCD_TENS(8), BCD_TENS(9)
+};
+
+// the value of the tens digit (upper nibble) of a BCD value
+static const uint8_t bcdTensValues[16] PROGMEM =
+{
+	0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150
+};
+
+// progress of a forced temperature conversion
+typedef enum
+{
+	TEMPERATURE_IDLE, // no conversion forced, or the last one has finished
+	TEMPERATURE_WAIT_BSY, // waiting for the ds3231 to finish its own conversion before CONV can be set
+	TEMPERATURE_CONVERTING // CONV set, waiting for the ds3231 to clear it
+} temperature_state_t;
+
+static volatile temperature_state_t temperatureState = TEMPERATURE_IDLE;
+static ds3231_temperature_callback_t temperatureCallback = NULL;
+static uint16_t temperatureLastPoll = 0; // the nowMs of the last poll made by ds3231TemperatureService
+static uint16_t temperatureWait = 0; // ms to wait after temperatureLastPoll before polling again
+static bool temperatureTimed = false; // false until ds3231TemperatureService has set temperatureLastPoll
+
+// days in the year before the first of each month, for a non leap year
+static const uint16_t daysBeforeMonth[MONTH_T_MAX] = { 0, 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+#define SECONDS_PER_DAY 86400UL
+#define DAYS_PER_4_YEARS 1461 // 3 * 365 + 366
+
+static void checkCentury(void);
+static uint8_t handleCenturyBit(uint8_t);
+static uint8_t decodeDateTime(const uint8_t *, datetime_t *);
+static uint8_t encodeTime(uint8_t, uint8_t, uint8_t, bool, uint8_t *);
+static uint8_t encodeHours(uint8_t, bool, uint8_t *);
+static uint8_t encodeDate(day_t, uint8_t, month_t, uint8_t, uint8_t *);
+static uint8_t validateAlarm(const alarm_t *);
+static uint8_t writeAlarmRegisters(alarm_number_t, const uint8_t *, bool);
+static bool pollTemperatureConversion(void);
+static uint8_t decToBcd(uint8_t);
+static uint8_t bcdToDec(uint8_t);
+static char *bcdToAscii(char *, uint8_t);
+static uint8_t decodeHours(uint8_t, bool *);
+static void loadRegisterCache(void);
+static void updateRegisterCache(uint8_t, const uint8_t *, uint8_t);
+static void mergeRegisterCache(uint8_t, uint8_t *, uint8_t);
+static uint8_t getCachedRegisterValue(uint8_t);
+static uint8_t writeCachedRegisterValue(uint8_t, uint8_t);
+static uint8_t setRegisterValue(uint8_t, uint8_t);
+static uint8_t setRegisterValues(const uint8_t *, uint8_t, uint8_t);
+static bool isResendable(uint8_t);
+#if DS3231_USE_REGISTER_CACHE
+static bool isSetByDs3231(uint8_t);
+#endif
 
 /*
    sets up i2c bus and resets any necessary flags. MUST be called before using 
-   the ds3231
+   the ds3231. The bus runs at DS3231_I2C_FREQUENCY (400 kHz Fast-mode by default)
 */
+#if DS3231_USE_I2C_MASTER
 void initDS3231(void)
 {
-	initI2C();
+	I2C_PROFILE_SCOPE(initDS3231);
+	initI2C(DS3231_I2C_FREQUENCY);
+	initDS3231OnBus(&i2cMasterBus);
+}
+#endif
+
+/*
+   as `initDS3231`, but for a ds3231 on any i2c bus, e.g. a bit-banged one (i2cSoftware.c) or
+   /dev/i2c-N on Linux (host/i2cLinux.c). The bus must already be set up
+	Param: ds3231Bus -> the bus the ds3231 is on, must stay valid while the ds3231 is used
+*/
+void initDS3231OnBus(const i2c_bus_t *ds3231Bus)
+{
+	I2C_PROFILE_SCOPE(initDS3231OnBus);
+	bus = ds3231Bus;
+	loadRegisterCache();
 
 	// clear any alarms
 	ds3231RemoveAlarm(ALARM_1);
@@ -16,18 +132,22 @@ void initDS3231(void)
 
 /*
    utility function to set the register pointer on
-   the ds3231
+   the ds3231. On a bus error the transfer is ended with a STOP
 	Param: reg -> the register to be pointed at by the register pointer
 	Returns: DS3231_OPERATION_SUCCESS (0) on success
 			 1 if the register provided was invalid
+			 2 if the ds3231 did not respond or the bus timed out
 */
 uint8_t setRegisterPointer(uint8_t reg)
 {
 	if(reg < DS3231_REGISTER_SECONDS || reg > DS3231_REGISTER_TEMPERATURE_LSB)
 		return 1;
 
-	i2cStart(DS3231_ADDRESS_WRITE);
-	i2cWrite(reg);
+	if(bus->start(bus, DS3231_ADDRESS_WRITE) != 0 || bus->write(bus, reg) != 0)
+	{
+		bus->stop(bus);
+		return 2;
+	}
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -35,18 +155,39 @@ uint8_t setRegisterPointer(uint8_t reg)
 /*
    utility function to get a registers value (single byte)
 	Param: reg -> the register to read
-	Returns: the value of the register (1 byte)
+	Returns: the value of the register (1 byte), 0 if the read failed
 */
 uint8_t getRegisterValue(uint8_t reg)
 {
-	setRegisterPointer(reg);
-	i2cRepeatStart(DS3231_ADDRESS_READ);
-	uint8_t registerValue = i2cReadNak();
-	i2cStop();
+	uint8_t registerValue = 0;
+	getRegisterValues(reg, &registerValue, 1);
 
 	return registerValue;
 }
 
+/*
+   utility function to read several consecutive registers in a single transaction. The
+   ds3231 auto increments its register pointer after every byte read, so only one START,
+   pointer write and STOP are needed no matter how many registers are read
+	Param: reg -> the first register to read
+		   values -> buffer the register values are stored in, must hold count bytes
+		   count -> the number of registers to read
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the register range provided was invalid
+			 2 if the ds3231 did not respond or the bus timed out, the register cache is left untouched
+*/
+uint8_t getRegisterValues(uint8_t reg, uint8_t *values, uint8_t count)
+{
+	if(count == 0 || reg + count - 1 > DS3231_REGISTER_TEMPERATURE_LSB)
+		return 1;
+
+	if(i2cBusReadRegisters(bus, DS3231_ADDRESS_WRITE, reg, values, count) != 0)
+		return 2;
+	mergeRegisterCache(reg, values, count);
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
 /*
    writes the value to the provided register of the
    ds3231
@@ -54,19 +195,305 @@ uint8_t getRegisterValue(uint8_t reg)
 		   reg -> the register to write the value to
     Returns: DS3231_OPERATION_SUCCESS (0) on success
 	         1 if the register provided was out of range
+			 2 if the ds3231 did not respond or the bus timed out
 */
 uint8_t writeValueThenStop(uint8_t value, uint8_t reg)
 {
-	if(reg < DS3231_REGISTER_SECONDS || reg > DS3231_REGISTER_TEMPERATURE_LSB)
+	return writeValuesThenStop(&value, 1, reg);
+}
+
+/*
+   writes several consecutive registers of the ds3231 in a single transaction, relying on
+   the register pointer auto incrementing after every byte written
+	Param: values -> the values to write, values[0] is written to reg
+		   count -> the number of registers to write
+		   reg -> the first register to write to
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the register range provided was invalid
+			 2 if the ds3231 did not respond or the bus timed out, the register cache is left untouched
+*/
+uint8_t writeValuesThenStop(const uint8_t *values, uint8_t count, uint8_t reg)
+{
+	if(count == 0 || reg + count - 1 > DS3231_REGISTER_TEMPERATURE_LSB)
 		return 1;
 
-	setRegisterPointer(reg);
-	i2cWrite(value);
-	i2cStop();
+	if(i2cBusWriteRegisters(bus, DS3231_ADDRESS_WRITE, reg, values, count) != 0)
+		return 2;
+	updateRegisterCache(reg, values, count);
 
 	return DS3231_OPERATION_SUCCESS;
 }
 
+/*
+   fills the register cache with a single burst read of every ds3231 register. Does nothing
+   if DS3231_USE_REGISTER_CACHE is 0
+*/
+static void loadRegisterCache(void)
+{
+#if DS3231_USE_REGISTER_CACHE
+	uint8_t values[DS3231_REGISTER_COUNT];
+	getRegisterValues(DS3231_REGISTER_SECONDS, values, DS3231_REGISTER_COUNT); // also fills the cache
+#endif
+}
+
+/*
+   keeps the register cache in step with values that have just been written to the ds3231,
+   marking them as no longer dirty. The CONV bit is never cached as the ds3231 clears it by
+   itself once a temperature conversion finishes
+	Param: reg -> the first register the values belong to
+		   values -> the register values
+		   count -> the number of values
+*/
+static void updateRegisterCache(uint8_t reg, const uint8_t *values, uint8_t count)
+{
+#if DS3231_USE_REGISTER_CACHE
+	for(uint8_t i = 0; i < count; i++, reg++)
+	{
+		uint8_t value = values[i];
+		if(reg == DS3231_REGISTER_CONTROL)
+			value &= ~DS3231_CONTROL_CONV_BIT;
+
+		registerCache[reg] = value;
+		registerCacheValid |= (uint32_t) 1 << reg;
+		registerDirty &= ~((uint32_t) 1 << reg);
+	}
+#endif
+}
+
+/*
+   keeps the register cache in step with values that have just been read from the ds3231.
+   Registers with a pending (dirty) write keep their cached value. For the configuration
+   registers that value is copied over the one read, so callers always see their own writes
+   even before a flush, keeping the CONV bit read. Registers the ds3231 changes by itself
+   (the time keeping registers) are returned as read
+	Param: reg -> the first register the values belong to
+		   values -> the register values read, dirty configuration registers are replaced in place
+		   count -> the number of values
+*/
+static void mergeRegisterCache(uint8_t reg, uint8_t *values, uint8_t count)
+{
+#if DS3231_USE_REGISTER_CACHE
+	for(uint8_t i = 0; i < count; i++, reg++)
+	{
+		if(registerDirty & ((uint32_t) 1 << reg))
+		{
+			if(!isSetByDs3231(reg))
+				values[i] = registerCache[reg] | (values[i] & (reg == DS3231_REGISTER_CONTROL ? DS3231_CONTROL_CONV_BIT : 0));
+			continue;
+		}
+
+		uint8_t value = values[i];
+		if(reg == DS3231_REGISTER_CONTROL)
+			value &= ~DS3231_CONTROL_CONV_BIT;
+
+		registerCache[reg] = value;
+		registerCacheValid |= (uint32_t) 1 << reg;
+	}
+#endif
+}
+
+/*
+   gets the value of a configuration register (CONTROL, STATUS, AGING OFFSET or an alarm
+   register). When the cache is enabled the value is served from RAM without touching the bus.
+   The CONV bit of the CONTROL register is always returned clear, and the OSF, BSY, A1F and A2F
+   bits of the STATUS register are only as fresh as the last time it was read, so code that
+   needs those bits must use `getRegisterValue` instead
+	Param: reg -> the register to get
+	Returns: the (cached) register value
+*/
+static uint8_t getCachedRegisterValue(uint8_t reg)
+{
+#if DS3231_USE_REGISTER_CACHE
+	if(!(registerCacheValid & ((uint32_t) 1 << reg)))
+		loadRegisterCache();
+
+	return registerCache[reg];
+#else
+	uint8_t value = getRegisterValue(reg);
+	if(reg == DS3231_REGISTER_CONTROL)
+		value &= ~DS3231_CONTROL_CONV_BIT;
+
+	return value;
+#endif
+}
+
+/*
+   sets a configuration register, see `setRegisterValue`. When the cache is enabled and already
+   holds the value the write is skipped entirely
+	Param: value -> the value to write to the register
+		   reg -> the register to write the value to
+	Returns: DS3231_OPERATION_SUCCESS (0)
+*/
+static uint8_t writeCachedRegisterValue(uint8_t value, uint8_t reg)
+{
+#if DS3231_USE_REGISTER_CACHE
+	if((registerCacheValid & ((uint32_t) 1 << reg)) && registerCache[reg] == value)
+		return DS3231_OPERATION_SUCCESS;
+#endif
+
+	return setRegisterValue(value, reg);
+}
+
+/*
+   sets a register of the ds3231. In the default write through mode this is the same as
+   `writeValueThenStop`. In write back mode (see `ds3231UseWriteBack`) the value is only stored
+   in the register cache and marked dirty, it is sent to the ds3231 by `ds3231Flush`. Writes
+   to STATUS and writes setting CONV are always sent straight away, see `setRegisterValues`
+	Param: value -> the value to set the register to
+		   reg -> the register to set
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the register provided was out of range
+*/
+static uint8_t setRegisterValue(uint8_t value, uint8_t reg)
+{
+	return setRegisterValues(&value, 1, reg);
+}
+
+/*
+   sets several consecutive registers of the ds3231, see `setRegisterValue`. In write back
+   mode a range covering STATUS, or setting the CONV bit of CONTROL, is sent straight away:
+   the ds3231 raises the STATUS flags and clears CONV by itself, so a copy held until the
+   flush would be stale and could clear a flag it raised in the meantime. Any pending writes
+   are flushed first, so the ds3231 sees the writes in the order they were made
+	Param: values -> the values to set, values[0] is set to reg
+		   count -> the number of registers to set
+		   reg -> the first register to set
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the register range provided was invalid
+*/
+static uint8_t setRegisterValues(const uint8_t *values, uint8_t count, uint8_t reg)
+{
+#if DS3231_USE_REGISTER_CACHE
+	if(useWriteBack)
+	{
+		if(count == 0 || reg + count - 1 > DS3231_REGISTER_TEMPERATURE_LSB)
+			return 1;
+
+		bool isStatus = reg <= DS3231_REGISTER_STATUS && reg + count > DS3231_REGISTER_STATUS;
+		bool isConv = reg <= DS3231_REGISTER_CONTROL && reg + count > DS3231_REGISTER_CONTROL &&
+			(values[DS3231_REGISTER_CONTROL - reg] & DS3231_CONTROL_CONV_BIT);
+		if(!isStatus && !isConv)
+		{
+			for(uint8_t i = 0; i < count; i++, reg++)
+			{
+				registerCache[reg] = values[i];
+				registerCacheValid |= (uint32_t) 1 << reg;
+				registerDirty |= (uint32_t) 1 << reg;
+			}
+
+			return DS3231_OPERATION_SUCCESS;
+		}
+
+		ds3231Flush();
+	}
+#endif
+
+	return writeValuesThenStop(values, count, reg);
+}
+
+/*
+   selects whether setters write to the ds3231 straight away (write through, the default) or
+   only update the register cache and mark the changed registers dirty (write back). In write
+   back mode nothing is sent until `ds3231Flush` is called, which lets many small changes be
+   coalesced into one or two bursts. Writes to STATUS (clearing alarm flags or OSF, setting an
+   alarm, EN32kHz) and forced temperature conversions are the exception, they flush and are
+   sent straight away, as is clearing the CENTURY bit once a new century has been counted.
+   Turning write back mode off flushes any pending writes.
+   Only available when DS3231_USE_REGISTER_CACHE is set
+	Param: writeBack -> true to defer writes until `ds3231Flush`, false to write through
+*/
+#if DS3231_USE_REGISTER_CACHE
+void ds3231UseWriteBack(bool writeBack)
+{
+	I2C_PROFILE_SCOPE(ds3231UseWriteBack);
+	if(!writeBack)
+		ds3231Flush();
+
+	useWriteBack = writeBack;
+}
+#endif
+
+/*
+   sends every dirty register to the ds3231 using as few auto incrementing burst writes as
+   possible. Dirty runs separated by a short gap of clean registers are merged into one burst
+   when the gap only holds configuration registers (alarms, CONTROL, AGING OFFSET) whose cached
+   value is known, as resending a byte is cheaper than a new START, address and pointer.
+   Timekeeping, STATUS and temperature registers are never resent as the ds3231 changes them.
+   Does nothing in write through mode as nothing is ever dirty
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if a write failed, the registers not yet sent stay dirty
+*/
+uint8_t ds3231Flush(void)
+{
+	I2C_PROFILE_SCOPE(ds3231Flush);
+#if DS3231_USE_REGISTER_CACHE
+	uint8_t reg = 0;
+	while(registerDirty)
+	{
+		while(!(registerDirty & ((uint32_t) 1 << reg)))
+			reg++;
+
+		uint8_t end = reg; // last register of the burst
+		uint8_t next = reg + 1;
+		while(next < DS3231_REGISTER_COUNT)
+		{
+			if(registerDirty & ((uint32_t) 1 << next))
+			{
+				end = next++;
+				continue;
+			}
+
+			// look for another dirty register within a bridgeable gap
+			uint8_t gapEnd = next;
+			while(gapEnd < DS3231_REGISTER_COUNT && gapEnd - next < DS3231_FLUSH_MAX_GAP && isResendable(gapEnd) && !(registerDirty & ((uint32_t) 1 << gapEnd)))
+				gapEnd++;
+
+			if(gapEnd >= DS3231_REGISTER_COUNT || !(registerDirty & ((uint32_t) 1 << gapEnd)))
+				break;
+
+			next = gapEnd;
+		}
+
+		if(writeValuesThenStop(&registerCache[reg], end - reg + 1, reg) != DS3231_OPERATION_SUCCESS) // clears the dirty bits
+			return 1;
+		reg = end + 1;
+	}
+#endif
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   checks if a clean register can be resent as part of a burst write without changing the
+   state of the ds3231
+	Param: reg -> the register to check
+	Returns: true if the cached value of reg can be safely written back to the ds3231
+*/
+static bool isResendable(uint8_t reg)
+{
+#if DS3231_USE_REGISTER_CACHE
+	if(!(registerCacheValid & ((uint32_t) 1 << reg)))
+		return false;
+
+	return !isSetByDs3231(reg);
+#else
+	return false;
+#endif
+}
+
+/*
+   checks if the ds3231 changes a register by itself: the time keeping registers, the STATUS
+   flags and the temperature. The CONV bit of CONTROL is handled separately
+	Param: reg -> the register to check
+	Returns: true if a cached copy of reg can go stale
+*/
+#if DS3231_USE_REGISTER_CACHE
+static bool isSetByDs3231(uint8_t reg)
+{
+	return reg <= DS3231_REGISTER_YEAR || reg == DS3231_REGISTER_STATUS || reg >= DS3231_REGISTER_TEMPERATURE_MSB;
+}
+#endif
+
 /*
    allows for alarms to be cleared/removed/deleted from the ds3231. This function clears
    the appropriate alarms registers, clears the alarm flag and clears the alarm enable bit.
@@ -75,45 +502,18 @@ uint8_t writeValueThenStop(uint8_t value, uint8_t reg)
 Param: alarm -> the alarm number to clear, e.g. ALARM_2
 Returns: DS3231_OPERATION_SUCCESS (0) if everything was ok
 		 1 if an invalid alarm number was provided
+		 2 if the ds3231 did not respond or the bus timed out
  */
 uint8_t ds3231RemoveAlarm(alarm_number_t alarm)
 {
+	I2C_PROFILE_SCOPE(ds3231RemoveAlarm);
 	if(alarm < 0 || alarm >= ALARM_NUMBER_T_MAX)
 		return 1;
 
-	// assume alarm 1, if alarm 2 this data gets changed
-	uint8_t minutesReg = DS3231_REGISTER_ALARM1_MINUTES;
-	uint8_t hoursReg = DS3231_REGISTER_ALARM1_HOURS;
-	uint8_t dayDateReg = DS3231_REGISTER_ALARM1_DAY_DATE;
-	uint8_t enableInterruptFlag = DS3231_CONTROL_A1IE_BIT;
-	uint8_t alarmFlag = DS3231_STATUS_A1F_BIT;
-
-	if(alarm == ALARM_2)
-	{
-		minutesReg = DS3231_REGISTER_ALARM2_MINUTES;
-		hoursReg = DS3231_REGISTER_ALARM2_HOURS;
-		dayDateReg = DS3231_REGISTER_ALARM2_DAY_DATE;
-		enableInterruptFlag = DS3231_CONTROL_A2IE_BIT;
-		alarmFlag = DS3231_STATUS_A2F_BIT;
-	}
-
-	if(alarm == ALARM_1) // only alarm1 has seconds register
-		writeValueThenStop(0, DS3231_REGISTER_ALARM1_SECONDS);
+	// clear the alarm registers, disable interrupts for the alarm and clear its flag
+	uint8_t alarmRegisters[DS3231_ALARM1_REGISTER_COUNT] = {0};
 
-	// clear mins, hours and day/date alarm registers
-	writeValueThenStop(0, minutesReg);
-	writeValueThenStop(0, hoursReg);
-	writeValueThenStop(0, dayDateReg);
-
-	// disable interrupts for alarm
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
-	writeValueThenStop(controlReg & ~enableInterruptFlag, DS3231_REGISTER_CONTROL);
-
-	// clear alarm flag
-	uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
-	writeValueThenStop(statusReg & ~alarmFlag, DS3231_REGISTER_STATUS);
-
-	return DS3231_OPERATION_SUCCESS;
+	return writeAlarmRegisters(alarm, alarmRegisters, false);
 }
 
 /*
@@ -129,6 +529,14 @@ void ds3231Use12HourMode(bool use12HourMode)
 	is24HourMode = !use12HourMode;
 }
 
+/*
+	Returns: true if 12 hour AM/PM mode has been selected with `ds3231Use12HourMode`
+*/
+bool ds3231Is12HourMode(void)
+{
+	return !is24HourMode;
+}
+
 /*
    ensures the alarm_t struct passed to set an alarm contains valid combinations of values 
 		Param: alarm -> pointer to the alarm the user supplied to be passed to the ds3231
@@ -244,7 +652,8 @@ static uint8_t validateAlarm(const alarm_t *alarm)
 }
 
 /*
-   sets an alarm on the ds3231. Also ensures INTCN and A1IE / A2IE is set so alarms will function
+   sets an alarm on the ds3231. Also ensures INTCN and A1IE / A2IE is set so alarms will function.
+   The alarm registers are built in RAM and written together with CONTROL and STATUS in a single burst
 		Param: alarm -> pointer to the alarm struct that contains all the info needed to 
 		set the alarm
 		Returns: DS3231_OPERATION_SUCCESS (0) if the alarm was valid
@@ -260,216 +669,607 @@ static uint8_t validateAlarm(const alarm_t *alarm)
 		10 unknown error occurred processing alarm 1
 		11 unknown error occurred processing alarm 2
 		12 unknown error occurred after handling alarm 1 or 2
+		13 if the ds3231 did not respond or the bus timed out
 */
 uint8_t ds3231SetAlarm(const alarm_t *alarm)
 {
+	I2C_PROFILE_SCOPE(ds3231SetAlarm);
 	uint8_t error = validateAlarm(alarm);
 	if(error)
 		return error;
 
-	// enable alarm interrupts
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
-	// ensure INTCN is set for alarms to trigger an interrupt on INTCN/SQW pin
-	// ensure A1IE / A2IE is enabled for alarm1/2 interrupts
-	controlReg |= DS3231_CONTROL_INTCN_BIT;
-	if(alarm->alarmNumber == ALARM_1)
-		controlReg |= DS3231_CONTROL_A1IE_BIT;
+	// every field of alarm 1, alarm 2 starts at its minutes register
+	uint8_t fields[DS3231_ALARM1_REGISTER_COUNT];
+	fields[0] = decToBcd(alarm->second);
+	fields[1] = decToBcd(alarm->minute);
+	fields[2] = decToBcd(alarm->hour);
+	if(alarm->useDay)
+		fields[3] = alarm->dayDate | DS3231_ALARM_DAY_BIT;
 	else
-		controlReg |= DS3231_CONTROL_A2IE_BIT;
-	writeValueThenStop(controlReg, DS3231_REGISTER_CONTROL);
+		fields[3] = decToBcd(alarm->dayDate);
 
-	if(alarm->alarmNumber == ALARM_1)
+	// fields that aren't matched by the trigger have their AxMy mask bit set instead
+	uint8_t matches = alarmTriggerMatches[alarm->trigger];
+	for(uint8_t i = 0; i < DS3231_ALARM1_REGISTER_COUNT; i++)
 	{
-		switch(alarm->trigger)
-		{
-			case A1_EVERY_SEC: // needs a1m1, a1m2, a1m3 and a1m4 all set
-				// set a1m1
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M1_BIT), DS3231_REGISTER_ALARM1_SECONDS);
-				// set a1m2
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M2_BIT), DS3231_REGISTER_ALARM1_MINUTES);
-				// set a1m3
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M3_BIT), DS3231_REGISTER_ALARM1_HOURS);
-				// set a1m4
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M4_BIT), DS3231_REGISTER_ALARM1_DAY_DATE);
-				break;
-
-			case A1_SEC_MATCH: // needs a1m2, a1m3 and a1m4 set
-				// set seconds
-				writeValueThenStop(decToBcd(alarm->second), DS3231_REGISTER_ALARM1_SECONDS);
-				// set a1m2
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M2_BIT), DS3231_REGISTER_ALARM1_MINUTES);
-				// set a1m3
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M3_BIT), DS3231_REGISTER_ALARM1_HOURS);
-				// set a1m4
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M4_BIT), DS3231_REGISTER_ALARM1_DAY_DATE);
-				break;
-
-			case A1_MIN_SEC_MATCH: // needs a1m3 and a1m4 set
-				// set seconds
-				writeValueThenStop(decToBcd(alarm->second), DS3231_REGISTER_ALARM1_SECONDS);
-				// set mins
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM1_MINUTES);
-				// set a1m3
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M3_BIT), DS3231_REGISTER_ALARM1_HOURS);
-				// set a1m4
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M4_BIT), DS3231_REGISTER_ALARM1_DAY_DATE);
-				break;
-
-			case A1_HOUR_MIN_SEC_MATCH: // needs a1m4 set
-				// set seconds
-				writeValueThenStop(decToBcd(alarm->second), DS3231_REGISTER_ALARM1_SECONDS);
-				// set mins
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM1_MINUTES);
-				// set hours
-				writeValueThenStop(decToBcd(alarm->hour), DS3231_REGISTER_ALARM1_HOURS);
-				// set a1m4
-				writeValueThenStop(decToBcd(DS3231_ALARM1_A1M4_BIT), DS3231_REGISTER_ALARM1_DAY_DATE);
-				break;
+		if(!(matches & (1 << i)))
+			fields[i] = DS3231_ALARM1_A1M1_BIT; // A1Mx and A2Mx are all bit 7
+	}
 
-			case A1_DAY_DATE_HOUR_MIN_SEC_MATCH: // no a1m* bits needed
-				// set seconds
-				writeValueThenStop(decToBcd(alarm->second), DS3231_REGISTER_ALARM1_SECONDS);
-				// set mins
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM1_MINUTES);
-				// set hours
-				writeValueThenStop(decToBcd(alarm->hour), DS3231_REGISTER_ALARM1_HOURS);
+	if(alarm->alarmNumber == ALARM_1)
+		error = writeAlarmRegisters(ALARM_1, fields, true);
+	else // alarm 2 has no seconds register
+		error = writeAlarmRegisters(ALARM_2, &fields[1], true);
 
-				// set day/date
-				if(alarm->useDay)
-					writeValueThenStop(alarm->dayDate | DS3231_ALARM_DAY_BIT, DS3231_REGISTER_ALARM1_DAY_DATE);
-				else
-					writeValueThenStop(decToBcd(alarm->dayDate), DS3231_REGISTER_ALARM1_DAY_DATE);
+	return error ? 13 : DS3231_OPERATION_SUCCESS;
+}
 
-				break;
+/*
+   writes an alarm's registers and updates its CONTROL and STATUS bits using as few
+   transactions as possible. The alarm registers, CONTROL and STATUS are consecutive, so
+   they are built in RAM and sent as a single burst. For ALARM_1 the burst has to pass
+   through the ALARM_2 registers, which is only done when their cached values are known,
+   otherwise the alarm registers and CONTROL/STATUS are sent as two bursts. The STATUS
+   register is read first so OSF is written back unchanged, the other alarm's flag is
+   written as 1 which the ds3231 ignores, so a flag raised since the read isn't lost
+	Param: alarm -> the alarm being written
+		   alarmRegisters -> the raw alarm register values, 4 for ALARM_1 (seconds first)
+		   					 or 3 for ALARM_2 (minutes first)
+		   enable -> true to set INTCN and the alarm's interrupt enable bit, false to clear
+		   			 the alarm's interrupt enable bit
+	Returns: DS3231_OPERATION_SUCCESS (0)
+			 2 if the ds3231 did not respond or the bus timed out. Nothing is written if
+			   STATUS could not be read, and CONTROL/STATUS aren't if the alarm registers failed
+*/
+static uint8_t writeAlarmRegisters(alarm_number_t alarm, const uint8_t *alarmRegisters, bool enable)
+{
+	// ALARM1_SECONDS through STATUS
+	uint8_t block[DS3231_REGISTER_STATUS - DS3231_REGISTER_ALARM1_SECONDS + 1];
+	uint8_t firstReg = DS3231_REGISTER_ALARM1_SECONDS;
+	uint8_t count = DS3231_ALARM1_REGISTER_COUNT;
+	uint8_t enableInterruptFlag = DS3231_CONTROL_A1IE_BIT;
+	uint8_t alarmFlag = DS3231_STATUS_A1F_BIT;
+	uint8_t otherAlarmFlag = DS3231_STATUS_A2F_BIT;
 
-			default: // this should never be reached, here to stop compiler warnings
-				break;
-		}
-	}
-	else // alarm 2
+	if(alarm == ALARM_2)
 	{
-		switch(alarm->trigger)
-		{
-			case A2_EVERY_MIN: // needs a2m2, a2m3 and a2m4 set
-				// set a2m2
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M2_BIT), DS3231_REGISTER_ALARM2_MINUTES);
-				// set a2m3
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M3_BIT), DS3231_REGISTER_ALARM2_HOURS);
-				// set a2m4
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M4_BIT), DS3231_REGISTER_ALARM2_DAY_DATE);
-				break;
-
-			case A2_MIN_MATCH: // a2m3 and a2m4 set
-				// set a2m3
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M3_BIT), DS3231_REGISTER_ALARM2_HOURS);
-				// set a2m4
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M4_BIT), DS3231_REGISTER_ALARM2_DAY_DATE);
-				// set minutes
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM2_MINUTES);
-				break;
-
-			case A2_HOUR_MIN_MATCH: // a2m4 set
-				// set a2m4
-				writeValueThenStop(decToBcd(DS3231_ALARM2_A2M4_BIT), DS3231_REGISTER_ALARM2_DAY_DATE);
-				// set minutes
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM2_MINUTES);
-				// set hours
-				writeValueThenStop(decToBcd(alarm->hour), DS3231_REGISTER_ALARM2_HOURS);
-				break;
+		firstReg = DS3231_REGISTER_ALARM2_MINUTES;
+		count = DS3231_ALARM2_REGISTER_COUNT;
+		enableInterruptFlag = DS3231_CONTROL_A2IE_BIT;
+		alarmFlag = DS3231_STATUS_A2F_BIT;
+		otherAlarmFlag = DS3231_STATUS_A1F_BIT;
+	}
 
-			case A2_DAY_DATE_HOUR_MIN_MATCH: // no a2m* bits needed, does need day/date bit set
-				// set minutes
-				writeValueThenStop(decToBcd(alarm->minute), DS3231_REGISTER_ALARM2_MINUTES);
-				// set hours
-				writeValueThenStop(decToBcd(alarm->hour), DS3231_REGISTER_ALARM2_HOURS);
+	uint8_t *values = &block[firstReg - DS3231_REGISTER_ALARM1_SECONDS];
+	for(uint8_t i = 0; i < count; i++)
+		values[i] = alarmRegisters[i];
 
-				if(alarm->useDay)
-					writeValueThenStop(alarm->dayDate | DS3231_ALARM_DAY_BIT, DS3231_REGISTER_ALARM2_DAY_DATE);
-				else
-					writeValueThenStop(decToBcd(alarm->dayDate), DS3231_REGISTER_ALARM2_DAY_DATE);
+	uint8_t controlReg = getCachedRegisterValue(DS3231_REGISTER_CONTROL);
+	if(enable) // INTCN must be set for alarms to trigger an interrupt on the INTCN/SQW pin
+		controlReg |= DS3231_CONTROL_INTCN_BIT | enableInterruptFlag;
+	else
+		controlReg &= ~enableInterruptFlag;
+	block[DS3231_REGISTER_CONTROL - DS3231_REGISTER_ALARM1_SECONDS] = controlReg;
 
-				break;
+	uint8_t statusReg;
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return 2;
+	statusReg = (statusReg & ~alarmFlag) | otherAlarmFlag;
+	block[DS3231_REGISTER_STATUS - DS3231_REGISTER_ALARM1_SECONDS] = statusReg;
 
-			default: // this should never be reached, here to stop compiler warnings
-				break;
-		}
+	uint8_t reg = firstReg + count;
+	for(; reg < DS3231_REGISTER_CONTROL; reg++) // bridge the alarm 2 registers if possible
+	{
+		if(!isResendable(reg))
+			break;
+		block[reg - DS3231_REGISTER_ALARM1_SECONDS] = getCachedRegisterValue(reg);
 	}
 
-	ds3231ClearAlarmFlag(alarm->alarmNumber);
-	return DS3231_OPERATION_SUCCESS;
+	if(reg == DS3231_REGISTER_CONTROL) // alarm registers through STATUS in one burst
+		return setRegisterValues(values, DS3231_REGISTER_STATUS - firstReg + 1, firstReg) ? 2 : DS3231_OPERATION_SUCCESS;
+
+	if(setRegisterValues(values, count, firstReg) != DS3231_OPERATION_SUCCESS)
+		return 2;
+	return setRegisterValues(&block[DS3231_REGISTER_CONTROL - DS3231_REGISTER_ALARM1_SECONDS], 2, DS3231_REGISTER_CONTROL) ? 2 : DS3231_OPERATION_SUCCESS;
 }
 
 /*
    used to reset an alarms flag (that indicates the alarm was triggered). This function does
-   NOT delete the alarm, to delete an alarm see the `ds3231RemoveAlarm` function
+   NOT delete the alarm, to delete an alarm see the `ds3231RemoveAlarm` function. The other
+   alarm's flag is written as 1, which the ds3231 ignores, so it isn't lost if that alarm
+   triggers between the read and the write
 		Param: alarm -> the alarm number flag to be reset, e.g. ALARM_1
 		Returns: DS3231_OPERATION_SUCCESS (0)
+				 2 if the ds3231 could not be read or written
 */
 uint8_t ds3231ClearAlarmFlag(alarm_number_t alarm)
 {
-	uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
+	I2C_PROFILE_SCOPE(ds3231ClearAlarmFlag);
+	uint8_t statusReg; // alarm flags are set by the ds3231 so must be read
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return 2;
 
-	if(alarm == ALARM_1)
-		writeValueThenStop(statusReg & ~DS3231_STATUS_A1F_BIT, DS3231_REGISTER_STATUS);
-	else 
-		writeValueThenStop(statusReg & ~DS3231_STATUS_A2F_BIT, DS3231_REGISTER_STATUS);
+	uint8_t alarmFlag = alarm == ALARM_1 ? DS3231_STATUS_A1F_BIT : DS3231_STATUS_A2F_BIT;
+	if(!(statusReg & alarmFlag)) // already clear
+		return DS3231_OPERATION_SUCCESS;
 
-	return DS3231_OPERATION_SUCCESS;
+	statusReg = (statusReg | DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT) & ~alarmFlag;
+	return setRegisterValue(statusReg, DS3231_REGISTER_STATUS) != DS3231_OPERATION_SUCCESS ? 2 : DS3231_OPERATION_SUCCESS;
 }
 
 /*
-   convenience function to set the ds3231 time using a single function
+   clears the flag of every triggered alarm with a single read and write of the STATUS
+   register, releasing the INT/SQW pin. Flags that were not set are written as 1, which leaves
+   them unchanged, so an alarm that triggers between the read and the write is not lost. The
+   write is always sent straight away, even in write back mode
+		Returns: a bitmask of the alarm flags that were set, DS3231_STATUS_A1F_BIT and/or
+				 DS3231_STATUS_A2F_BIT. 0 if no alarm had triggered (or the STATUS register could not be read)
+*/
+uint8_t ds3231ClearAlarmFlags(void)
+{
+	I2C_PROFILE_SCOPE(ds3231ClearAlarmFlags);
+	uint8_t statusReg;
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return 0;
+
+	uint8_t flags = statusReg & (DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT);
+	if(flags)
+		writeValueThenStop(statusReg ^ (DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT), DS3231_REGISTER_STATUS); // set flags -> 0, clear flags -> 1
+
+	return flags;
+}
+
+/*
+   convenience function to set the ds3231 time using a single function. The values are
+   validated up front and then written with a single burst, so the SECONDS, MINUTES and HOURS
+   registers all change at the same instant
 Param: hour -> the hour to set the ds3231 to
 	   minute -> the minute to set the ds3231 to
 	   second -> the second to set the ds3231 to
 	   isPM -> used to indicate whether the hours value should be treated as a PM value
 	   		   this should only be true if 12 hour AM/PM mode is activated and it is a PM value. 
 			   By default 12 hour AM/PM mode is NOT enabled
+Returns: DS3231_OPERATION_SUCCESS (0) if everything worked
+		 1 if an invalid hours value was supplied for 24 hour mode
+		 2 if an invalid hours value was supplied for 12 hour mode
+		 3 if the minutes value was invalid (> 59)
+		 4 if the seconds value was invalid (> 59)
 */
 uint8_t ds3231SetTime(uint8_t hour, uint8_t minute, uint8_t second, bool isPM)
 {
-	uint8_t error = DS3231_OPERATION_SUCCESS;
-	error |= ds3231SetHour(hour, isPM);
-	error |= ds3231SetMinute(minute);
-	error |= ds3231SetSecond(second);
+	I2C_PROFILE_SCOPE(ds3231SetTime);
+	uint8_t registers[3];
+	uint8_t error = encodeTime(hour, minute, second, isPM, registers);
+	if(error)
+		return error;
 
-	return error == DS3231_OPERATION_SUCCESS ? DS3231_OPERATION_SUCCESS : error;
+	setRegisterValues(registers, 3, DS3231_REGISTER_SECONDS);
+
+	return DS3231_OPERATION_SUCCESS;
 }
 
 /*
-   allows the day, date, month, year and century to be set with a single function call
+   allows the day, date, month, year and century to be set with a single function call. The
+   values are validated up front and then written with a single burst
 		Param: day -> the desired day the DS3231 will be set to
 			   date -> the desired date the DS3231 will be set to
 			   month -> the desired month the DS3231 will be set to
 			   year -> the desired year the DS3231 will be set to
 			   century -> the desired century the DS3231 will be set to
-		Returns: DS3231_OPERATION_SUCCESS (0) if everything worked, otherwise a non-zero error
+		Returns: DS3231_OPERATION_SUCCESS (0) if everything worked
+				 1 if the day provided was invalid
+				 2 if the date provided was out of range
+				 3 if the month provided was out of range
+				 4 if the year is invalid (> 99)
 */
 uint8_t ds3231SetFullDate(day_t day, uint8_t date, month_t month, uint8_t year, uint8_t century)
 {
-	uint8_t error = DS3231_OPERATION_SUCCESS;
-	error |= ds3231SetDay(day);
-	error |= ds3231SetDate(date);
-	error |= ds3231SetMonth(month);
-	error |= ds3231SetYear(year);
+	I2C_PROFILE_SCOPE(ds3231SetFullDate);
+	uint8_t registers[4];
+	uint8_t error = encodeDate(day, date, month, year, registers);
+	if(error)
+		return error;
+
+	setRegisterValues(registers, 4, DS3231_REGISTER_DAY);
 	ds3231SetCentury(century);
 
-	return error == DS3231_OPERATION_SUCCESS ? DS3231_OPERATION_SUCCESS : error;
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   sets the full date and time of the ds3231 in a single transaction. Every field is
+   validated before anything is sent, then registers SECONDS through YEAR are written with
+   one auto incrementing burst. As the countdown chain is reset when the SECONDS register is
+   written, all fields take effect at the same instant
+		Param: dateTime -> the date and time to set the ds3231 to. The isPM field is only
+						   used in 12 hour mode
+		Returns: DS3231_OPERATION_SUCCESS (0) if everything worked
+				 1 if an invalid hours value was supplied for 24 hour mode
+				 2 if an invalid hours value was supplied for 12 hour mode
+				 3 if the minutes value was invalid (> 59)
+				 4 if the seconds value was invalid (> 59)
+				 5 if the day provided was invalid
+				 6 if the date provided was out of range
+				 7 if the month provided was out of range
+				 8 if the year is invalid (> 99)
+*/
+uint8_t ds3231SetDateTime(const datetime_t *dateTime)
+{
+	I2C_PROFILE_SCOPE(ds3231SetDateTime);
+	uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+	uint8_t error = encodeTime(dateTime->hour, dateTime->minute, dateTime->second, dateTime->isPM, &registers[DS3231_REGISTER_SECONDS]);
+	if(error)
+		return error;
+
+	error = encodeDate(dateTime->day, dateTime->date, dateTime->month, dateTime->year, &registers[DS3231_REGISTER_DAY]);
+	if(error)
+		return error + 4;
+
+	setRegisterValues(registers, DS3231_DATETIME_REGISTER_COUNT, DS3231_REGISTER_SECONDS);
+	ds3231SetCentury(dateTime->century);
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   validates a time and encodes it into the raw SECONDS, MINUTES and HOURS register values
+		Param: hour, minute, second, isPM -> see `ds3231SetTime`
+			   registers -> buffer of 3 bytes the raw values are stored in, in register order
+		Returns: DS3231_OPERATION_SUCCESS (0) if the time was valid
+				 1 if an invalid hours value was supplied for 24 hour mode
+				 2 if an invalid hours value was supplied for 12 hour mode
+				 3 if the minutes value was invalid (> 59)
+				 4 if the seconds value was invalid (> 59)
+*/
+static uint8_t encodeTime(uint8_t hour, uint8_t minute, uint8_t second, bool isPM, uint8_t *registers)
+{
+	uint8_t error = encodeHours(hour, isPM, &registers[2]);
+	if(error)
+		return error;
+	if(minute > 59)
+		return 3;
+	if(second > 59)
+		return 4;
+
+	registers[0] = decToBcd(second);
+	registers[1] = decToBcd(minute);
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   validates an hour for the selected hour mode and encodes it into a raw HOURS register value.
+   Used by every setter of the hours, so they all accept the same range
+		Param: hour -> 0 to 23 in 24 hour mode, 1 to 12 in 12 hour mode
+			   isPM -> see `ds3231SetHour`, ignored in 24 hour mode
+			   hoursRegister -> where the raw value is stored, untouched if hour is invalid
+		Returns: DS3231_OPERATION_SUCCESS (0) if the hour was valid
+				 1 if an invalid hours value was supplied for 24 hour mode
+				 2 if an invalid hours value was supplied for 12 hour mode
+*/
+static uint8_t encodeHours(uint8_t hour, bool isPM, uint8_t *hoursRegister)
+{
+	if(is24HourMode && hour > 23)
+		return 1;
+	if(!is24HourMode && (hour == 0 || hour > 12))
+		return 2;
+
+	uint8_t hoursValue = decToBcd(hour);
+	if(!is24HourMode) // set special bits for 12 hr mode
+	{
+		hoursValue |= DS3231_HOUR_MODE_12_BIT; // bit 6 indicates the mode
+		if(isPM)
+			hoursValue |= DS3231_PM_BIT;
+	}
+
+	*hoursRegister = hoursValue;
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   validates a date and encodes it into the raw DAY, DATE, MONTH/CENTURY and YEAR register values
+		Param: day, date, month, year -> see `ds3231SetFullDate`
+			   registers -> buffer of 4 bytes the raw values are stored in, in register order
+		Returns: DS3231_OPERATION_SUCCESS (0) if the date was valid
+				 1 if the day provided was invalid
+				 2 if the date provided was out of range
+				 3 if the month provided was out of range
+				 4 if the year is invalid (> 99)
+*/
+static uint8_t encodeDate(day_t day, uint8_t date, month_t month, uint8_t year, uint8_t *registers)
+{
+	if(day < SUNDAY || day >= DAY_T_MAX)
+		return 1;
+	if(date == 0 || date > 31)
+		return 2;
+	if(month < JANUARY || month >= MONTH_T_MAX)
+		return 3;
+	if(year > 99)
+		return 4;
+
+	registers[0] = decToBcd((uint8_t) day);
+	registers[1] = decToBcd(date);
+	registers[2] = decToBcd((uint8_t) month); // writing the month also clears the century bit
+	registers[3] = decToBcd(year);
+
+	return DS3231_OPERATION_SUCCESS;
 }
 
 /*
    checks to see if the CENTURY_BIT bit is set in the MONTH register. If it is then a new century has been entered so the currentCentury counter is incremented.
-   This function should be called at the start / end of every other function that interacts with the DS3231, otherwise turning a century will be missed. However if it is unlikely that the DS3231 will experience a change in century, this function can be ignored and removed from the rest of the library code 
+   To avoid an extra transaction on every access the century is only checked where the MONTH register is read anyway (`ds3231GetMonth`, `ds3231GetDateTime`), by `ds3231GetCentury` and by `ds3231SetMonth`, which would otherwise clear the bit without counting it. Reading one of these at least once every 100 years is enough to never miss a new century. If the DS3231 will never see a change in century, define DS3231_TRACK_CENTURY as 0 to remove century handling entirely
  */
 static void checkCentury(void)
 {
-	uint8_t month = getRegisterValue(DS3231_REGISTER_MONTH_CENTURY);
-	if(month & DS3231_CENTURY_BIT) // entered a new century
+#if DS3231_TRACK_CENTURY
+	handleCenturyBit(getRegisterValue(DS3231_REGISTER_MONTH_CENTURY));
+#endif
+}
+
+/*
+   increments the century counter if the CENTURY_BIT is set in the raw month register value
+   provided, then clears the bit on the ds3231 so the same rollover isn't counted twice. The
+   bit is cleared with an immediate write, even in write back mode, as the ds3231 keeps
+   reporting it until then. A pending write of the MONTH register is sent along with it.
+   The century is only counted once the bit has been cleared, so a failed write leaves it
+   to be counted by the next read. If DS3231_TRACK_CENTURY is 0 the bit is only masked off
+	Param: monthRegister -> the raw (BCD) value read from the MONTH/CENTURY register
+	Returns: the raw month register value with the CENTURY_BIT cleared
+*/
+static uint8_t handleCenturyBit(uint8_t monthRegister)
+{
+#if DS3231_TRACK_CENTURY
+	if(monthRegister & DS3231_CENTURY_BIT) // entered a new century
+	{
+		monthRegister &= ~(DS3231_CENTURY_BIT); // this forces the century bit clear whilst keeping the correct month
+
+		uint8_t value = monthRegister;
+#if DS3231_USE_REGISTER_CACHE
+		if(registerDirty & ((uint32_t) 1 << DS3231_REGISTER_MONTH_CENTURY))
+			value = registerCache[DS3231_REGISTER_MONTH_CENTURY];
+#endif
+		if(writeValueThenStop(value, DS3231_REGISTER_MONTH_CENTURY) == DS3231_OPERATION_SUCCESS)
+			century++;
+	}
+
+	return monthRegister;
+#else
+	return monthRegister & ~DS3231_CENTURY_BIT;
+#endif
+}
+
+/*
+   reads the full date and time from the ds3231 in a single transaction. Registers SECONDS
+   through YEAR are burst read, so the values all come from the same instant and can't tear
+   when the seconds roll over between reads. The century is handled from the same snapshot
+	Param: dateTime -> the struct the date and time will be stored in
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 2 if the ds3231 could not be read
+*/
+uint8_t ds3231GetDateTime(datetime_t *dateTime)
+{
+	I2C_PROFILE_SCOPE(ds3231GetDateTime);
+	uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+	if(getRegisterValues(DS3231_REGISTER_SECONDS, registers, DS3231_DATETIME_REGISTER_COUNT) != DS3231_OPERATION_SUCCESS)
+		return 2;
+
+	return decodeDateTime(registers, dateTime);
+}
+
+/*
+   queues an interrupt driven read of the full date and time and returns straight away, so
+   the CPU is free while the transfer runs. Once the transaction's status is
+   I2C_TRANSACTION_DONE (or its callback has run) the registers can be turned into a
+   datetime_t with `ds3231DecodeDateTime`
+	Param: transaction -> zero initialised descriptor used for the transfer, must stay valid
+						  until the transfer has finished
+		   registers -> buffer of DS3231_DATETIME_REGISTER_COUNT bytes the raw registers are read into
+		   callback -> called from the TWI interrupt once the transfer has finished, may be NULL
+	Returns: DS3231_OPERATION_SUCCESS (0) if the transfer was queued
+			 1 if the transaction is already queued or running
+*/
+uint8_t ds3231RequestDateTime(i2c_transaction_t *transaction, uint8_t *registers, void (*callback)(i2c_transaction_t *))
+{
+	I2C_PROFILE_SCOPE(ds3231RequestDateTime);
+	static const uint8_t firstRegister = DS3231_REGISTER_SECONDS;
+
+	transaction->address = DS3231_ADDRESS_WRITE;
+	transaction->writeBuffer = &firstRegister;
+	transaction->writeLength = 1;
+	transaction->readBuffer = registers;
+	transaction->readLength = DS3231_DATETIME_REGISTER_COUNT;
+	transaction->callback = callback;
+
+	return i2cBusSubmit(bus, transaction);
+}
+
+/*
+   checks whether a transfer queued by `ds3231RequestDateTime` (or any other transaction queued
+   on the bus the ds3231 is on) is still running, e.g. before the AVR is put to sleep
+	Returns: true if transactions are queued or running, false if the bus is idle
+*/
+bool ds3231IsBusy(void)
+{
+	return bus != NULL && i2cBusIsBusy(bus) != 0;
+}
+
+/*
+   turns the raw registers read by `ds3231RequestDateTime` into a datetime_t. The century is
+   handled from the same snapshot, which may write to the ds3231 when a new century has been
+   entered, so this must not be called from a transaction callback
+	Param: registers -> the DS3231_DATETIME_REGISTER_COUNT raw registers, SECONDS first
+		   dateTime -> the struct the date and time will be stored in
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+*/
+uint8_t ds3231DecodeDateTime(uint8_t *registers, datetime_t *dateTime)
+{
+	mergeRegisterCache(DS3231_REGISTER_SECONDS, registers, DS3231_DATETIME_REGISTER_COUNT);
+
+	return decodeDateTime(registers, dateTime);
+}
+
+/*
+   reads the full date and time from the ds3231 in a single transaction and writes it as an
+   ISO-8601 string, see `ds3231FormatDateTime`. The century is handled as in `ds3231GetDateTime`
+	Param: buffer -> at least DS3231_DATETIME_STRING_LENGTH characters
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 2 if the ds3231 could not be read, buffer is left untouched
+*/
+uint8_t ds3231GetDateTimeString(char *buffer)
+{
+	I2C_PROFILE_SCOPE(ds3231GetDateTimeString);
+	uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+	if(getRegisterValues(DS3231_REGISTER_SECONDS, registers, DS3231_DATETIME_REGISTER_COUNT) != DS3231_OPERATION_SUCCESS)
+		return 2;
+
+	registers[DS3231_REGISTER_MONTH_CENTURY] = handleCenturyBit(registers[DS3231_REGISTER_MONTH_CENTURY]);
+	ds3231FormatDateTime(registers, buffer);
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   writes a raw register snapshot, such as one read by `ds3231RequestDateTime`, as an ISO-8601
+   string "YYYY-MM-DDTHH:MM:SS" (24 hour, even in 12 hour mode). The BCD registers are turned
+   into digits directly, so nothing is converted to binary and back. Nothing is read or written,
+   so this may be called from a transaction callback, a century bit that is still set counts
+   as the next century
+	Param: registers -> the DS3231_DATETIME_REGISTER_COUNT raw registers, SECONDS first
+		   buffer -> at least DS3231_DATETIME_STRING_LENGTH characters, nul terminated
+	Returns: the position of the nul terminator, so more text can be appended
+*/
+char *ds3231FormatDateTime(const uint8_t *registers, char *buffer)
+{
+	uint8_t month = registers[DS3231_REGISTER_MONTH_CENTURY];
+	uint8_t currentCentury = century;
+#if DS3231_TRACK_CENTURY
+	if(month & DS3231_CENTURY_BIT)
+		currentCentury++;
+#endif
+
+	uint8_t hours = registers[DS3231_REGISTER_HOURS];
+	if(hours & DS3231_HOUR_MODE_12_BIT)
 	{
-		century++;
-		month &= ~(DS3231_CENTURY_BIT); // this forces the century bit clear whilst keeping the correct month
-		ds3231SetMonth((month_t) month); 
+		bool isPM;
+		uint8_t hour = decodeHours(hours, &isPM);
+		if(hour == 12) // 12 AM is hour 0
+			hour = 0;
+		if(isPM)
+			hour += 12;
+		hours = decToBcd(hour);
 	}
+
+	buffer = bcdToAscii(buffer, decToBcd(currentCentury - 1));
+	buffer = bcdToAscii(buffer, registers[DS3231_REGISTER_YEAR]);
+	*buffer++ = '-';
+	buffer = bcdToAscii(buffer, month & 0x1f);
+	*buffer++ = '-';
+	buffer = bcdToAscii(buffer, registers[DS3231_REGISTER_DATE] & 0x3f);
+	*buffer++ = 'T';
+	buffer = bcdToAscii(buffer, hours & 0x3f);
+	*buffer++ = ':';
+	buffer = bcdToAscii(buffer, registers[DS3231_REGISTER_MINUTES] & 0x7f);
+	*buffer++ = ':';
+	buffer = bcdToAscii(buffer, registers[DS3231_REGISTER_SECONDS] & 0x7f);
+	*buffer = '\0';
+
+	return buffer;
+}
+
+/*
+   turns a snapshot of registers SECONDS through YEAR into a datetime_t, handling the century
+	Param: registers -> the DS3231_DATETIME_REGISTER_COUNT raw registers, SECONDS first
+		   dateTime -> the struct the date and time will be stored in
+	Returns: DS3231_OPERATION_SUCCESS (0)
+*/
+static uint8_t decodeDateTime(const uint8_t *registers, datetime_t *dateTime)
+{
+	uint8_t month = handleCenturyBit(registers[DS3231_REGISTER_MONTH_CENTURY]);
+
+	dateTime->second = bcdToDec(registers[DS3231_REGISTER_SECONDS]);
+	dateTime->minute = bcdToDec(registers[DS3231_REGISTER_MINUTES]);
+	dateTime->hour = decodeHours(registers[DS3231_REGISTER_HOURS], &dateTime->isPM);
+	dateTime->day = (day_t) bcdToDec(registers[DS3231_REGISTER_DAY]);
+	dateTime->date = bcdToDec(registers[DS3231_REGISTER_DATE]);
+	dateTime->month = (month_t) bcdToDec(month);
+	dateTime->year = bcdToDec(registers[DS3231_REGISTER_YEAR]);
+	dateTime->century = century;
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   decodes a raw HOURS register value, taking the 12/24 hour mode bits into account
+	Param: hoursRegister -> the raw (BCD) value read from the HOURS register
+		   isPM -> set to true if the register holds a 12 hour mode PM time, false otherwise
+	Returns: the decimal hours value
+*/
+static uint8_t decodeHours(uint8_t hoursRegister, bool *isPM)
+{
+	if(hoursRegister & DS3231_HOUR_MODE_12_BIT)
+	{
+		*isPM = hoursRegister & DS3231_PM_BIT;
+		return bcdToDec(hoursRegister & 0x1f);
+	}
+
+	*isPM = false;
+	return bcdToDec(hoursRegister & 0x3f);
+}
+
+/*
+   converts a 24 hour mode date and time to the number of seconds since 2000-01-01 00:00:00.
+   Like the ds3231, every year divisible by 4 is treated as a leap year. The day field is ignored
+	Param: dateTime -> the date and time to convert, century 21 or later
+	Returns: the seconds since 2000-01-01 00:00:00 (good until 2136)
+*/
+uint32_t ds3231DateTimeToSeconds(const datetime_t *dateTime)
+{
+	uint16_t years = (dateTime->century - 21) * 100 + dateTime->year; // years since 2000
+	uint32_t days = (uint32_t) years * 365 + (years + 3) / 4; // every earlier year divisible by 4 adds a leap day
+
+	days += daysBeforeMonth[dateTime->month] + dateTime->date - 1;
+	if(dateTime->month > FEBRUARY && dateTime->year % 4 == 0)
+		days++;
+
+	return days * SECONDS_PER_DAY + (uint32_t) dateTime->hour * 3600 + dateTime->minute * 60 + dateTime->second;
+}
+
+/*
+   converts a number of seconds since 2000-01-01 00:00:00 to a 24 hour mode date and time,
+   the inverse of `ds3231DateTimeToSeconds`. The day of the week is worked out assuming
+   SUNDAY is the first day, as in day_t
+	Param: seconds -> the seconds since 2000-01-01 00:00:00
+		   dateTime -> the struct the date and time will be stored in
+*/
+void ds3231SecondsToDateTime(uint32_t seconds, datetime_t *dateTime)
+{
+	uint32_t days = seconds / SECONDS_PER_DAY;
+	uint32_t timeOfDay = seconds % SECONDS_PER_DAY;
+
+	dateTime->hour = timeOfDay / 3600;
+	dateTime->minute = (timeOfDay / 60) % 60;
+	dateTime->second = timeOfDay % 60;
+	dateTime->isPM = false;
+	dateTime->day = (day_t) ((days + SATURDAY - 1) % 7 + 1); // 2000-01-01 was a saturday
+
+	uint16_t years = (days / DAYS_PER_4_YEARS) * 4;
+	uint16_t dayOfYear = days % DAYS_PER_4_YEARS;
+	if(dayOfYear >= 366) // past the leap year that starts every 4 year block
+	{
+		dayOfYear -= 366;
+		years += 1 + dayOfYear / 365;
+		dayOfYear %= 365;
+	}
+	bool isLeapYear = years % 4 == 0;
+
+	uint8_t month = DECEMBER;
+	while(daysBeforeMonth[month] + (isLeapYear && month > FEBRUARY) > dayOfYear)
+		month--;
+
+	dateTime->date = dayOfYear - daysBeforeMonth[month] - (isLeapYear && month > FEBRUARY) + 1;
+	dateTime->month = (month_t) month;
+	dateTime->year = years % 100;
+	dateTime->century = 21 + years / 100;
 }
 
 /*
@@ -478,6 +1278,7 @@ static void checkCentury(void)
 */
 uint8_t ds3231GetCentury(void)
 {
+	I2C_PROFILE_SCOPE(ds3231GetCentury);
 	checkCentury();
 	return century;
 }
@@ -499,11 +1300,11 @@ void ds3231SetCentury(uint8_t cent)
 */
 uint8_t ds3231SetYear(uint8_t year)
 {
+	I2C_PROFILE_SCOPE(ds3231SetYear);
 	if(year > 99)
 		return 1;
 
-	checkCentury();
-	writeValueThenStop(decToBcd(year), DS3231_REGISTER_YEAR);
+	setRegisterValue(decToBcd(year), DS3231_REGISTER_YEAR);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -514,24 +1315,27 @@ uint8_t ds3231SetYear(uint8_t year)
 */
 uint8_t ds3231GetYear(void)
 {
-	checkCentury();
+	I2C_PROFILE_SCOPE(ds3231GetYear);
 	uint8_t year = getRegisterValue(DS3231_REGISTER_YEAR);
 
 	return bcdToDec(year);
 }
 
 /*
-   sets the month on the ds3231
+   sets the month on the ds3231. A new century the ds3231 has flagged is counted first, as
+   writing the month clears the CENTURY bit
 	Param: month -> the month to set the ds3231 to
 	Returns: DS3231_OPERATION_SUCCESS (0) on success
 		     1 if the month provided was out of range
 */
 uint8_t ds3231SetMonth(month_t month)
 {
+	I2C_PROFILE_SCOPE(ds3231SetMonth);
 	if(month < 0 || month >= MONTH_T_MAX)
 		return 1;
 
-	writeValueThenStop(decToBcd((uint8_t) month), DS3231_REGISTER_MONTH_CENTURY);
+	checkCentury(); // writing the month clears the CENTURY bit, so count a new century first
+	setRegisterValue(decToBcd((uint8_t) month), DS3231_REGISTER_MONTH_CENTURY);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -542,8 +1346,8 @@ uint8_t ds3231SetMonth(month_t month)
 */
 month_t ds3231GetMonth(void)
 {
-	checkCentury();
-	uint8_t month = getRegisterValue(DS3231_REGISTER_MONTH_CENTURY);
+	I2C_PROFILE_SCOPE(ds3231GetMonth);
+	uint8_t month = handleCenturyBit(getRegisterValue(DS3231_REGISTER_MONTH_CENTURY));
 
 	return (month_t) bcdToDec(month);
 }
@@ -556,11 +1360,11 @@ month_t ds3231GetMonth(void)
 */
 uint8_t ds3231SetDate(uint8_t date)
 {
+	I2C_PROFILE_SCOPE(ds3231SetDate);
 	if(date > 31)
 		return 1;
 
-	checkCentury();
-	writeValueThenStop(decToBcd(date), DS3231_REGISTER_DATE);
+	setRegisterValue(decToBcd(date), DS3231_REGISTER_DATE);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -571,7 +1375,7 @@ uint8_t ds3231SetDate(uint8_t date)
 */
 uint8_t ds3231GetDate(void)
 {
-	checkCentury();
+	I2C_PROFILE_SCOPE(ds3231GetDate);
 	uint8_t date = getRegisterValue(DS3231_REGISTER_DATE);
 
 	return bcdToDec(date);
@@ -585,11 +1389,11 @@ uint8_t ds3231GetDate(void)
  */
 uint8_t ds3231SetDay(day_t day)
 {
+	I2C_PROFILE_SCOPE(ds3231SetDay);
 	if(day < 0 || day >= DAY_T_MAX)
 		return 1;
 
-	checkCentury();
-	writeValueThenStop(decToBcd((uint8_t) day), DS3231_REGISTER_DAY);
+	setRegisterValue(decToBcd((uint8_t) day), DS3231_REGISTER_DAY);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -600,7 +1404,7 @@ uint8_t ds3231SetDay(day_t day)
 */
 day_t ds3231GetDay(void)
 {
-	checkCentury();
+	I2C_PROFILE_SCOPE(ds3231GetDay);
 	uint8_t day = getRegisterValue(DS3231_REGISTER_DAY);
 
 	return (day_t) bcdToDec(day);
@@ -615,40 +1419,30 @@ day_t ds3231GetDay(void)
 				  isPM is ignored if 24 hour mode is being used
    Return: DS3231_OPERATION_SUCCESS (0) if setting the hours worked
    		   1 if an invalid hours value was supplied for 24 hour mode
-   		   2 if an invalid hours value was supplied for 12 hour mode
+   		   2 if an invalid hours value was supplied for 12 hour mode (0 or > 12)
 */
 uint8_t ds3231SetHour(uint8_t hours, bool isPM)
 {
-	if(is24HourMode && hours > 23)
-		return 1;
-	if(!is24HourMode && hours > 12)
-		return 2;
-
-	checkCentury();
-	uint8_t hoursValue = 0; // used to build the byte to send
-	if(!is24HourMode) // set special bits for 12 hr mode
-	{
-		hoursValue |= DS3231_HOUR_MODE_12_BIT; // bit 6 indicates the mode
-		if(isPM)
-			hoursValue |= DS3231_PM_BIT;
-	}
+	I2C_PROFILE_SCOPE(ds3231SetHour);
+	uint8_t hoursValue;
+	uint8_t error = encodeHours(hours, isPM, &hoursValue);
+	if(error)
+		return error;
 
-	hoursValue |= decToBcd(hours);
-	writeValueThenStop(hoursValue, DS3231_REGISTER_HOURS);
+	setRegisterValue(hoursValue, DS3231_REGISTER_HOURS);
 
 	return DS3231_OPERATION_SUCCESS;
 }
 
 /*
    allows the ds3231 hour value to be retreived
-	Returns: the hours value the ds3231 has currently stored
+	Returns: the hours value the ds3231 has currently stored, 1 to 12 in 12 hour mode
 */
 uint8_t ds3231GetHour(void)
 {
-	checkCentury();
-	uint8_t hours = getRegisterValue(DS3231_REGISTER_HOURS);
-
-	return bcdToDec(hours);
+	I2C_PROFILE_SCOPE(ds3231GetHour);
+	bool isPM;
+	return decodeHours(getRegisterValue(DS3231_REGISTER_HOURS), &isPM);
 }
 
 /*
@@ -659,11 +1453,11 @@ uint8_t ds3231GetHour(void)
 */
 uint8_t ds3231SetMinute(uint8_t minutes)
 {
+	I2C_PROFILE_SCOPE(ds3231SetMinute);
 	if(minutes > 59) // invalid condition
 		return 1;
 
-	checkCentury();
-	writeValueThenStop(decToBcd(minutes), DS3231_REGISTER_MINUTES);
+	setRegisterValue(decToBcd(minutes), DS3231_REGISTER_MINUTES);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -674,7 +1468,7 @@ uint8_t ds3231SetMinute(uint8_t minutes)
 */
 uint8_t ds3231GetMinute(void)
 {
-	checkCentury();
+	I2C_PROFILE_SCOPE(ds3231GetMinute);
 	uint8_t minutes = getRegisterValue(DS3231_REGISTER_MINUTES);
 
 	return bcdToDec(minutes);
@@ -688,11 +1482,11 @@ uint8_t ds3231GetMinute(void)
  */
 uint8_t ds3231SetSecond(uint8_t seconds)
 {
+	I2C_PROFILE_SCOPE(ds3231SetSecond);
 	if(seconds > 59)
 		return 1; // invalid condition
 
-	checkCentury();
-	writeValueThenStop(decToBcd(seconds), DS3231_REGISTER_SECONDS);
+	setRegisterValue(decToBcd(seconds), DS3231_REGISTER_SECONDS);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -703,7 +1497,7 @@ uint8_t ds3231SetSecond(uint8_t seconds)
 */
 uint8_t ds3231GetSecond(void)
 {
-	checkCentury();
+	I2C_PROFILE_SCOPE(ds3231GetSecond);
 	uint8_t seconds = getRegisterValue(DS3231_REGISTER_SECONDS);
 
 	return bcdToDec(seconds);
@@ -718,8 +1512,9 @@ uint8_t ds3231GetSecond(void)
 */
 uint8_t ds3231DisableOscillatorOnBattery(void)
 {
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
-	writeValueThenStop(controlReg | DS3231_CONTROL_EOSC_BIT, DS3231_REGISTER_CONTROL);
+	I2C_PROFILE_SCOPE(ds3231DisableOscillatorOnBattery);
+	uint8_t controlReg = getCachedRegisterValue(DS3231_REGISTER_CONTROL);
+	writeCachedRegisterValue(controlReg | DS3231_CONTROL_EOSC_BIT, DS3231_REGISTER_CONTROL);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -730,8 +1525,9 @@ uint8_t ds3231DisableOscillatorOnBattery(void)
 */
 uint8_t ds3231EnableOscillatorOnBattery(void)
 {
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
-	writeValueThenStop(controlReg & ~DS3231_CONTROL_EOSC_BIT, DS3231_REGISTER_CONTROL);
+	I2C_PROFILE_SCOPE(ds3231EnableOscillatorOnBattery);
+	uint8_t controlReg = getCachedRegisterValue(DS3231_REGISTER_CONTROL);
+	writeCachedRegisterValue(controlReg & ~DS3231_CONTROL_EOSC_BIT, DS3231_REGISTER_CONTROL);
 
 	return DS3231_OPERATION_SUCCESS;
 }
@@ -744,7 +1540,8 @@ uint8_t ds3231EnableOscillatorOnBattery(void)
 */
 uint8_t ds3231EnableBBSQW(bbsqw_frequency_t freq)
 {
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
+	I2C_PROFILE_SCOPE(ds3231EnableBBSQW);
+	uint8_t controlReg = getCachedRegisterValue(DS3231_REGISTER_CONTROL);
 	controlReg &= ~(DS3231_CONTROL_INTCN_BIT); // clear intc otherwise bbsqw will not work
 	controlReg |= DS3231_CONTROL_BBQSW_BIT;
 	switch(freq)
@@ -765,42 +1562,135 @@ uint8_t ds3231EnableBBSQW(bbsqw_frequency_t freq)
 			controlReg |= (DS3231_CONTROL_RS1_BIT | DS3231_CONTROL_RS2_BIT);
 			break;
 		default:
-			i2cStop();
 			return 1;
 	}
 
-	writeValueThenStop(controlReg, DS3231_REGISTER_CONTROL);
+	writeCachedRegisterValue(controlReg, DS3231_REGISTER_CONTROL);
 
 	return DS3231_OPERATION_SUCCESS;
 }
 
 /*
    the ds3231 updates the temperature values every 64 seconds, however a user can force
-   a new temperature reading by setting the CONV bit in the CONTROL register
+   a new temperature reading by setting the CONV bit in the CONTROL register. Blocks until
+   the new reading is ready, polling every DS3231_TEMPERATURE_POLL_INTERVAL_MS. See
+   `ds3231StartTemperatureConversion` for a version that doesn't block
 */
 void ds3231ForceTemperatureUpdate(void)
 {
-	bool busy = true;
-	do // loop until BSY is clear (we can start our conversion)
+	I2C_PROFILE_SCOPE(ds3231ForceTemperatureUpdate);
+	ds3231StartTemperatureConversion(NULL);
+
+	while(!ds3231IsTemperatureReady())
+		_delay_ms(DS3231_TEMPERATURE_POLL_INTERVAL_MS);
+}
+
+/*
+   starts a forced temperature conversion and returns straight away. If the ds3231 is busy
+   with its own conversion CONV is set once that has finished. Progress is made by calling
+   `ds3231TemperatureService` (rate limited) or `ds3231IsTemperatureReady` (one poll per call),
+   a conversion takes around 125 ms to 200 ms
+	Param: callback -> run with the new `ds3231GetTemperature` value once the conversion has
+					   finished, NULL for none
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if a forced conversion is already in progress
+*/
+uint8_t ds3231StartTemperatureConversion(ds3231_temperature_callback_t callback)
+{
+	I2C_PROFILE_SCOPE(ds3231StartTemperatureConversion);
+	if(temperatureState != TEMPERATURE_IDLE)
+		return 1;
+
+	temperatureCallback = callback;
+	temperatureState = TEMPERATURE_WAIT_BSY;
+	temperatureTimed = false;
+	pollTemperatureConversion();
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   checks whether a forced temperature conversion has finished. While one is in progress
+   every call makes a single read of the ds3231, otherwise no bus time is used
+	Returns: true if no forced conversion is in progress (the temperature registers are up to date)
+*/
+bool ds3231IsTemperatureReady(void)
+{
+	I2C_PROFILE_SCOPE(ds3231IsTemperatureReady);
+	if(temperatureState == TEMPERATURE_IDLE)
+		return true;
+
+	return pollTemperatureConversion();
+}
+
+/*
+   call regularly from the main loop to move a forced temperature conversion along without
+   flooding the bus. The ds3231 is first polled DS3231_TEMPERATURE_CONVERSION_MS after CONV is
+   set, then every DS3231_TEMPERATURE_POLL_INTERVAL_MS, so a conversion costs a handful of
+   transactions. Any millisecond time base can be used, it may wrap around
+	Param: nowMs -> the current time in ms
+	Returns: true if no forced conversion is in progress
+*/
+bool ds3231TemperatureService(uint16_t nowMs)
+{
+	I2C_PROFILE_SCOPE(ds3231TemperatureService);
+	if(temperatureState == TEMPERATURE_IDLE)
+		return true;
+
+	if(!temperatureTimed) // first call since the conversion was started
 	{
-		uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
+		temperatureTimed = true;
+		temperatureLastPoll = nowMs;
+		temperatureWait = temperatureState == TEMPERATURE_CONVERTING ? DS3231_TEMPERATURE_CONVERSION_MS : DS3231_TEMPERATURE_POLL_INTERVAL_MS;
+		return false;
+	}
 
-		if(!(statusReg & DS3231_STATUS_BSY_BIT))
-			busy = false;
-	} while(busy);
+	if((uint16_t) (nowMs - temperatureLastPoll) < temperatureWait)
+		return false;
 
-	// set the CONV bit to start a new conversion
-	uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
-	writeValueThenStop(controlReg | DS3231_CONTROL_CONV_BIT, DS3231_REGISTER_CONTROL);
+	temperature_state_t previousState = temperatureState;
+	bool ready = pollTemperatureConversion();
 
-	busy = true;
-	do // loop until CONV becomes clear (conversion complete)
+	temperatureLastPoll = nowMs;
+	if(previousState == TEMPERATURE_WAIT_BSY && temperatureState == TEMPERATURE_CONVERTING)
+		temperatureWait = DS3231_TEMPERATURE_CONVERSION_MS;
+	else
+		temperatureWait = DS3231_TEMPERATURE_POLL_INTERVAL_MS;
+
+	return ready;
+}
+
+/*
+   moves a forced temperature conversion one step along with a single read (plus the CONV
+   write once BSY is clear). A failed read leaves the state unchanged, so it is retried
+	Returns: true if the conversion has finished
+*/
+static bool pollTemperatureConversion(void)
+{
+	uint8_t reg;
+
+	switch(temperatureState)
 	{
-		uint8_t controlReg = getRegisterValue(DS3231_REGISTER_CONTROL);
+		case TEMPERATURE_WAIT_BSY: // BSY must be clear before CONV is set
+			if(getRegisterValues(DS3231_REGISTER_STATUS, &reg, 1) != DS3231_OPERATION_SUCCESS || (reg & DS3231_STATUS_BSY_BIT))
+				return false;
+
+			if(writeValueThenStop(getCachedRegisterValue(DS3231_REGISTER_CONTROL) | DS3231_CONTROL_CONV_BIT, DS3231_REGISTER_CONTROL) == DS3231_OPERATION_SUCCESS)
+				temperatureState = TEMPERATURE_CONVERTING;
+			return false;
 
-		if(!(controlReg & DS3231_CONTROL_CONV_BIT))
-			busy = false;
-	} while(busy);
+		case TEMPERATURE_CONVERTING: // the ds3231 clears CONV once the conversion is complete
+			if(getRegisterValues(DS3231_REGISTER_CONTROL, &reg, 1) != DS3231_OPERATION_SUCCESS || (reg & DS3231_CONTROL_CONV_BIT))
+				return false;
+
+			temperatureState = TEMPERATURE_IDLE;
+			if(temperatureCallback != NULL)
+				temperatureCallback(ds3231GetTemperature());
+			return true;
+
+		default:
+			return true;
+	}
 }
 
 /*
@@ -813,33 +1703,65 @@ void ds3231ForceTemperatureUpdate(void)
    which is +25
    And the following 2 bits (01) are the fractional part of the temperature, which is 0.25
    So the tempreature read was +25.25
+	Both registers are read in a single transaction, so the two halves always come from the
+	same conversion.
 	NOTE: the ds3231 has a valid temperature reading at around 2 seconds after first powering on,
 	reading the temperature before this will likely lead to an incorrect result
 		Returns: encoded 10 bit temperature value
 */
 uint16_t ds3231GetTemperature(void)
 {
-	uint8_t temperatureUpper = getRegisterValue(DS3231_REGISTER_TEMPERATURE_MSB);
-	uint8_t temperatureLower = getRegisterValue(DS3231_REGISTER_TEMPERATURE_LSB);
+	I2C_PROFILE_SCOPE(ds3231GetTemperature);
+	uint8_t temperature[2] = { 0, 0 };
+	getRegisterValues(DS3231_REGISTER_TEMPERATURE_MSB, temperature, 2);
+
+	return (temperature[0] << 8) | temperature[1];
+}
+
+/*
+   reads the temperature sensor of the ds3231 (in a single transaction) and decodes it
+		Returns: the temperature in hundredths of a degree celcius, e.g. 2525 for +25.25 and
+				 -1075 for -10.75. The resolution is 0.25 degrees
+*/
+int16_t ds3231GetTemperatureHundredths(void)
+{
+	I2C_PROFILE_SCOPE(ds3231GetTemperatureHundredths);
+	return ds3231TemperatureToHundredths(ds3231GetTemperature());
+}
+
+/*
+   decodes a temperature value returned by `ds3231GetTemperature` using integer maths only
+	Param: temperature -> the encoded temperature
+		Returns: the temperature in hundredths of a degree celcius
+*/
+int16_t ds3231TemperatureToHundredths(uint16_t temperature)
+{
+	int16_t quarters = (int8_t) (temperature >> 8) * 4 + ((temperature >> 6) & 0x3);
 
-	return (temperatureUpper << 8) | temperatureLower;
+	return quarters * 25;
 }
 
 /*
    checks if the OSCILLATOR STOPPED FLAG (OSF) is set, if so the oscillator was stopped at some point, therefore the validity of the data held in the ds3231's registers may be at risk.
-   Also, clears the OSF flag if it was set
-		Returns: true if the oscillator has stopped at some point, false if it hasn't
+   Also, clears the OSF flag if it was set, writing the alarm flags as 1 so an alarm that
+   triggers between the read and the write isn't lost
+		Returns: true if the oscillator has stopped at some point, false if it hasn't (or the
+				 STATUS register could not be read)
 */
 bool ds3231HasOscillatorStopped(void)
 {
-	uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
+	I2C_PROFILE_SCOPE(ds3231HasOscillatorStopped);
+	uint8_t statusReg;
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return false;
 
 	bool didStop = false;
 	if(statusReg & DS3231_STATUS_OSF_BIT) // oscillator stopped flag set
 	{
 		didStop = true;
 		// now reset the flag
-		writeValueThenStop(statusReg & ~DS3231_STATUS_OSF_BIT, DS3231_REGISTER_STATUS);
+		statusReg |= DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT;
+		writeCachedRegisterValue(statusReg & ~DS3231_STATUS_OSF_BIT, DS3231_REGISTER_STATUS);
 	}
 
 	return didStop;
@@ -849,27 +1771,43 @@ bool ds3231HasOscillatorStopped(void)
    enables the 32KHz square wave output signal. The oscillator must be running for this
    wave to be output
 		Returns: DS3231_OPERATION_SUCCESS (0)
+				 2 if the ds3231 could not be read or written
 */
 uint8_t ds3231Enable32KHzOutput(void)
 {
-	uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
-	if(statusReg & ~DS3231_STATUS_EN32KHZ_BIT) // wasn't enabled, so enable it
-		writeValueThenStop(statusReg | DS3231_STATUS_EN32KHZ_BIT, DS3231_REGISTER_STATUS);
+	I2C_PROFILE_SCOPE(ds3231Enable32KHzOutput);
+	if(getCachedRegisterValue(DS3231_REGISTER_STATUS) & DS3231_STATUS_EN32KHZ_BIT) // already enabled
+		return DS3231_OPERATION_SUCCESS;
+
+	// OSF is written back as read, the alarm flags as 1 which the ds3231 ignores, so an alarm
+	// that triggers between the read and the write isn't lost
+	uint8_t statusReg;
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return 2;
+	statusReg |= DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT;
 
-	return DS3231_OPERATION_SUCCESS;
+	return writeCachedRegisterValue(statusReg | DS3231_STATUS_EN32KHZ_BIT, DS3231_REGISTER_STATUS) != DS3231_OPERATION_SUCCESS ? 2 : DS3231_OPERATION_SUCCESS;
 }
 
 /*
    disables the 32KHz square wave output signal
 		Returns: DS3231_OPERATION_SUCCESS (0)
+				 2 if the ds3231 could not be read or written
 */
 uint8_t ds3231Disable32KhzOutput(void)
 {
-	uint8_t statusReg = getRegisterValue(DS3231_REGISTER_STATUS);
-	if(statusReg & DS3231_STATUS_EN32KHZ_BIT) // is enabled, so disable it
-		writeValueThenStop(statusReg & ~DS3231_STATUS_EN32KHZ_BIT, DS3231_REGISTER_STATUS);
+	I2C_PROFILE_SCOPE(ds3231Disable32KhzOutput);
+	if(!(getCachedRegisterValue(DS3231_REGISTER_STATUS) & DS3231_STATUS_EN32KHZ_BIT)) // already disabled
+		return DS3231_OPERATION_SUCCESS;
+
+	// OSF is written back as read, the alarm flags as 1 which the ds3231 ignores, so an alarm
+	// that triggers between the read and the write isn't lost
+	uint8_t statusReg;
+	if(getRegisterValues(DS3231_REGISTER_STATUS, &statusReg, 1) != DS3231_OPERATION_SUCCESS)
+		return 2;
+	statusReg |= DS3231_STATUS_A1F_BIT | DS3231_STATUS_A2F_BIT;
 
-	return DS3231_OPERATION_SUCCESS;
+	return writeCachedRegisterValue(statusReg & ~DS3231_STATUS_EN32KHZ_BIT, DS3231_REGISTER_STATUS) != DS3231_OPERATION_SUCCESS ? 2 : DS3231_OPERATION_SUCCESS;
 }
 
 /*
@@ -879,8 +1817,8 @@ uint8_t ds3231Disable32KhzOutput(void)
 */
 uint8_t ds3231SetAgingOffset(int8_t offset)
 {
-	writeValueThenStop(offset, DS3231_REGISTER_AGING_OFFSET);
-	return DS3231_OPERATION_SUCCESS;
+	I2C_PROFILE_SCOPE(ds3231SetAgingOffset);
+	return writeCachedRegisterValue(offset, DS3231_REGISTER_AGING_OFFSET);
 }
 
 /*
@@ -889,7 +1827,8 @@ uint8_t ds3231SetAgingOffset(int8_t offset)
 */
 int8_t ds3231GetAgingOffset(void)
 {
-	return getRegisterValue(DS3231_REGISTER_AGING_OFFSET);
+	I2C_PROFILE_SCOPE(ds3231GetAgingOffset);
+	return getCachedRegisterValue(DS3231_REGISTER_AGING_OFFSET);
 }
 
 /*
@@ -899,7 +1838,10 @@ int8_t ds3231GetAgingOffset(void)
 */
 static uint8_t decToBcd(uint8_t val)
 {
-  return (val / 10 * 16) + (val % 10);
+	if(val > 99) // BCD registers only hold 2 digits
+		val = 99;
+
+	return pgm_read_byte(&bcdValues[val]);
 }
 
 /*
@@ -910,5 +1852,18 @@ static uint8_t decToBcd(uint8_t val)
 */
 static uint8_t bcdToDec(uint8_t val)
 {
-  return (val / 16 * 10) + (val % 16);
+	return pgm_read_byte(&bcdTensValues[val >> 4]) + (val & 0x0f);
+}
+
+/*
+   writes a BCD value as 2 ascii digits
+	Param: buffer -> where the digits are written
+		   val -> the BCD value
+	Returns: the position after the digits
+*/
+static char *bcdToAscii(char *buffer, uint8_t val)
+{
+	*buffer++ = '0' + (val >> 4);
+	*buffer++ = '0' + (val & 0x0f);
+	return buffer;
 }
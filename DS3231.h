@@ -4,11 +4,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "i2cMaster.h"
+#include "i2cBus.h"
+
 #define DS3231_ADDRESS_READ 0b11010001
 #define DS3231_ADDRESS_WRITE 0b11010000
 
 #define DS3231_OPERATION_SUCCESS 0 // this is returned if a function ran without errors
 
+// SCL frequency used by initDS3231, the ds3231 supports up to 400 kHz
+#ifndef DS3231_I2C_FREQUENCY
+#define DS3231_I2C_FREQUENCY I2C_DEFAULT_FREQUENCY
+#endif
+
+// set to 0 if the ds3231 is only used on other buses with initDS3231OnBus (e.g. on Linux), which
+// removes initDS3231 and every use of the i2cMaster.h functions
+#ifndef DS3231_USE_I2C_MASTER
+#define DS3231_USE_I2C_MASTER 1
+#endif
+
+// set to 0 to always read the CONTROL, STATUS and AGING OFFSET registers from the ds3231
+// instead of serving their configuration bits from a RAM copy
+#ifndef DS3231_USE_REGISTER_CACHE
+#define DS3231_USE_REGISTER_CACHE 1
+#endif
+
+// set to 0 if the ds3231 will never cross a century, this removes all century handling
+#ifndef DS3231_TRACK_CENTURY
+#define DS3231_TRACK_CENTURY 1
+#endif
+
 // general time keeping registers
 #define DS3231_REGISTER_SECONDS 0
 #define DS3231_REGISTER_MINUTES 0x1
@@ -18,12 +43,17 @@
 #define DS3231_REGISTER_MONTH_CENTURY 0x5
 #define DS3231_REGISTER_YEAR 0x6 
 
+#define DS3231_DATETIME_REGISTER_COUNT 7 // number of registers from SECONDS to YEAR inclusive
+#define DS3231_DATETIME_STRING_LENGTH 20 // "YYYY-MM-DDTHH:MM:SS" and the nul terminator
+
 // alarm 1 registers
 #define DS3231_REGISTER_ALARM1_SECONDS 0x7
 #define DS3231_REGISTER_ALARM1_MINUTES 0x8
 #define DS3231_REGISTER_ALARM1_HOURS 0x9
 #define DS3231_REGISTER_ALARM1_DAY_DATE 0xa
 
+#define DS3231_ALARM1_REGISTER_COUNT 4
+
 // alarm 1 trigger interval bits
 #define DS3231_ALARM1_A1M1_BIT (1 << 7) // used to signal when an alarm should be triggered (e.g. every second etc.)
 #define DS3231_ALARM1_A1M2_BIT (1 << 7) // used to signal when an alarm should be triggered (e.g. every second etc.)
@@ -35,6 +65,8 @@
 #define DS3231_REGISTER_ALARM2_HOURS 0xc
 #define DS3231_REGISTER_ALARM2_DAY_DATE 0xd
 
+#define DS3231_ALARM2_REGISTER_COUNT 3
+
 // alarm 2 trigger interval bits
 #define DS3231_ALARM2_A2M2_BIT (1 << 7) // used to signal when an alarm should be triggered (e.g. every second etc.)
 #define DS3231_ALARM2_A2M3_BIT (1 << 7)
@@ -73,6 +105,21 @@
 #define DS3231_REGISTER_TEMPERATURE_MSB 0x11
 #define DS3231_REGISTER_TEMPERATURE_LSB 0x12
 
+#define DS3231_REGISTER_COUNT 0x13 // number of registers from SECONDS to TEMPERATURE_LSB inclusive
+
+// how often a forced temperature conversion is polled, and how long to wait before the first poll
+#ifndef DS3231_TEMPERATURE_POLL_INTERVAL_MS
+#define DS3231_TEMPERATURE_POLL_INTERVAL_MS 20
+#endif
+#ifndef DS3231_TEMPERATURE_CONVERSION_MS
+#define DS3231_TEMPERATURE_CONVERSION_MS 125
+#endif
+
+// the largest run of clean registers ds3231Flush will resend to merge two dirty runs into one burst
+#ifndef DS3231_FLUSH_MAX_GAP
+#define DS3231_FLUSH_MAX_GAP 2
+#endif
+
 // special toggle bits
 #define DS3231_HOUR_MODE_12_BIT (1 << 6) // this will be 1 in the HOURS register if 12 hour mode is selected. 0 if 24 hour mode selected
 #define DS3231_PM_BIT (1 << 5) // if using 12 hr mode, this bit is set in the HOURS register to indicate if the time is AM or PM with PM being indicated by a 1 and AM by a 0
@@ -168,23 +215,33 @@ typedef enum
 	BBSQW_FREQUENCY_MAX	
 } bbsqw_frequency_t;
 
+// a full date and time snapshot, read from the ds3231 in a single transaction
+typedef struct
+{
+	uint8_t second;
+	uint8_t minute;
+	uint8_t hour;
+	bool isPM; // only meaningful if 12 hour mode is being used
+	day_t day;
+	uint8_t date;
+	month_t month;
+	uint8_t year;
+	uint8_t century; // 21 = 20xx, 22 = 21xx etc.
+} datetime_t;
+
+// run when a forced temperature conversion has finished, with the new ds3231GetTemperature value
+typedef void (*ds3231_temperature_callback_t)(uint16_t);
 
-////////////////////////////////////////////////////////////////
-// Global variables                                           //
-////////////////////////////////////////////////////////////////
-// used to track the century
-static uint8_t century = 21; // year 20xx has a century of 21
-// used to indicate the hour storing mode, either AM/PM (12 hour mode) or 24 hour mode
-static bool is24HourMode = true;
 
 ////////////////////////////////////////////////////////////////
 // Function prototypes                                        //
 ////////////////////////////////////////////////////////////////
 void initDS3231(void);
+void initDS3231OnBus(const i2c_bus_t *);
 
 // time setting / getting functions
-static void checkCentury(void);
 void ds3231Use12HourMode(bool);
+bool ds3231Is12HourMode(void);
 
 uint8_t ds3231SetSecond(uint8_t);
 uint8_t ds3231GetSecond(void);
@@ -213,15 +270,30 @@ uint8_t ds3231GetCentury(void);
 uint8_t ds3231SetFullDate(day_t, uint8_t, month_t, uint8_t, uint8_t);
 uint8_t ds3231SetTime(uint8_t, uint8_t, uint8_t, bool);
 
+uint8_t ds3231SetDateTime(const datetime_t *);
+uint8_t ds3231GetDateTime(datetime_t *);
+uint8_t ds3231RequestDateTime(i2c_transaction_t *, uint8_t *, void (*)(i2c_transaction_t *));
+bool ds3231IsBusy(void);
+uint8_t ds3231DecodeDateTime(uint8_t *, datetime_t *);
+uint8_t ds3231GetDateTimeString(char *);
+char *ds3231FormatDateTime(const uint8_t *, char *);
+uint32_t ds3231DateTimeToSeconds(const datetime_t *);
+void ds3231SecondsToDateTime(uint32_t, datetime_t *);
+
 // alarm functions
-static uint8_t validateAlarm(const alarm_t *);
 uint8_t ds3231SetAlarm(const alarm_t *);
 uint8_t ds3231ClearAlarmFlag(alarm_number_t);
+uint8_t ds3231ClearAlarmFlags(void);
 uint8_t ds3231RemoveAlarm(alarm_number_t);
 
 // temperature functions
 void ds3231ForceTemperatureUpdate(void);
+uint8_t ds3231StartTemperatureConversion(ds3231_temperature_callback_t);
+bool ds3231IsTemperatureReady(void);
+bool ds3231TemperatureService(uint16_t);
 uint16_t ds3231GetTemperature(void);
+int16_t ds3231GetTemperatureHundredths(void);
+int16_t ds3231TemperatureToHundredths(uint16_t);
 
 // oscillator functions
 uint8_t ds3231DisableOscillatorOnBattery(void);
@@ -240,10 +312,16 @@ int8_t ds3231GetAgingOffset(void);
 uint8_t ds3231EnableBBSQW(bbsqw_frequency_t);
 
 // utility functions
-static uint8_t decToBcd(uint8_t);
-static uint8_t bcdToDec(uint8_t);
 uint8_t setRegisterPointer(uint8_t);
 uint8_t getRegisterValue(uint8_t);
+uint8_t getRegisterValues(uint8_t, uint8_t *, uint8_t);
 uint8_t writeValueThenStop(uint8_t, uint8_t);
+uint8_t writeValuesThenStop(const uint8_t *, uint8_t, uint8_t);
+
+// register cache functions
+#if DS3231_USE_REGISTER_CACHE
+void ds3231UseWriteBack(bool);
+#endif
+uint8_t ds3231Flush(void);
 
 #endif
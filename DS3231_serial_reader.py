@@ -1,21 +1,139 @@
-# allows the reading of the LM75A temperature values via a USART / UART to USB
-# adapter
-# requires pyserial to be installed
-
-import serial
-import time
-import math
-
-# /dev/ttyUSB0 needs to be changed to the port the USART to USB adapter
-# is plugged in to
-ser = serial.Serial("/dev/ttyUSB0", 9600) # C code defaults to 9600 baud
-ser.flush()
-
-receivedCounter = 0
-while True:
-	msb = int(ser.read().encode('hex'), 16)
-	counterString = ("[{0:<6}] " + str(msb)).format(receivedCounter)
-
-	print counterString
-	receivedCounter += 1
-	ser.flush()
+# reads the telemetry frames sent by telemetry.c via a USART / UART to USB
+# adapter and prints every record
+# requires pyserial to be installed, works with python 2 and 3
+#
+# frame  -> COBS(sequence, record..., crc high byte, crc low byte) 0x00
+# record -> type, payload length, payload (little endian)
+
+from __future__ import print_function
+
+import struct
+import sys
+
+TELEMETRY_DATETIME = 1
+TELEMETRY_TEMPERATURE = 2
+TELEMETRY_TEMPERATURE_SUMMARY = 3
+TELEMETRY_ALARM = 4
+TELEMETRY_STATUS = 5
+TELEMETRY_ALARM_ERROR = 6
+
+DATETIME_12_HOUR = 1 << 0
+DATETIME_PM = 1 << 1
+
+DAYS = ["", "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"]
+
+def crc16(data):
+	# CRC-16/CCITT-FALSE, the same as _crc_xmodem_update starting from 0xffff
+	crc = 0xffff
+	for byte in bytearray(data):
+		crc ^= byte << 8
+		for i in range(8):
+			if crc & 0x8000:
+				crc = ((crc << 1) ^ 0x1021) & 0xffff
+			else:
+				crc = (crc << 1) & 0xffff
+	return crc
+
+def cobsDecode(data):
+	# returns None if the data isn't valid COBS
+	data = bytearray(data)
+	decoded = bytearray()
+	i = 0
+	while i < len(data):
+		code = data[i]
+		if code == 0 or i + code > len(data):
+			return None
+		decoded += data[i + 1:i + code]
+		i += code
+		if code != 0xff and i < len(data):
+			decoded.append(0)
+	return decoded
+
+def decodeFrame(data):
+	# returns (sequence, [(type, payload), ...]) or None if the frame is corrupt
+	frame = cobsDecode(data)
+	if frame is None or len(frame) < 3:
+		return None
+	if crc16(frame[:-2]) != (frame[-2] << 8 | frame[-1]):
+		return None
+
+	records = []
+	payload = frame[1:-2]
+	i = 0
+	while i + 2 <= len(payload):
+		recordType, length = payload[i], payload[i + 1]
+		if i + 2 + length > len(payload):
+			return None
+		records.append((recordType, bytes(payload[i + 2:i + 2 + length])))
+		i += 2 + length
+	if i != len(payload):
+		return None
+
+	return frame[0], records
+
+def formatRecord(recordType, payload):
+	if recordType == TELEMETRY_DATETIME and len(payload) >= 9:
+		century, year, month, date, day, hour, minute, second, flags = struct.unpack("<9B", payload[:9])
+		text = "{0:02}{1:02}-{2:02}-{3:02} {4:02}:{5:02}:{6:02}".format(century - 1, year, month, date, hour, minute, second)
+		if flags & DATETIME_12_HOUR:
+			text += " PM" if flags & DATETIME_PM else " AM"
+		return text + " " + DAYS[day if day < len(DAYS) else 0]
+	if recordType == TELEMETRY_TEMPERATURE and len(payload) >= 2:
+		return "temperature {0:.2f} *C".format(struct.unpack("<h", payload[:2])[0] / 100.0)
+	if recordType == TELEMETRY_TEMPERATURE_SUMMARY and len(payload) >= 20:
+		start, end, count, low, high, mean, variance = struct.unpack("<IIHhhhI", payload[:20])
+		return ("temperature summary of {0} samples ({1}s to {2}s since 2000): min {3:.2f} max {4:.2f} "
+			"mean {5:.2f} sd {6:.2f} *C").format(count, start, end, low / 100.0, high / 100.0, mean / 100.0, variance ** 0.5 / 100.0)
+	if recordType == TELEMETRY_ALARM and len(payload) >= 1:
+		return "alarm {0} triggered".format(bytearray(payload)[0] + 1)
+	if recordType == TELEMETRY_STATUS and len(payload) >= 2:
+		return "control 0x{0:02x} status 0x{1:02x}".format(*struct.unpack("<2B", payload[:2]))
+	if recordType == TELEMETRY_ALARM_ERROR and len(payload) >= 2:
+		alarm, error = struct.unpack("<2B", payload[:2])
+		return "alarm {0} could not be set, error {1}".format(alarm + 1, error)
+	return "unknown record type {0} ({1} bytes)".format(recordType, len(payload))
+
+def readFrames(ser):
+	# yields (sequence, records, framesLost) for every valid frame, framesLost counts the
+	# frames missing or corrupted since the last valid one
+	data = bytearray()
+	lastSequence = None
+	corrupted = 0
+	while True:
+		byte = bytearray(ser.read(1))
+		if not byte:
+			continue
+		if byte[0] != 0:
+			data += byte
+			continue
+
+		frame = decodeFrame(data)
+		data = bytearray()
+		if frame is None:
+			corrupted += 1
+			continue
+
+		sequence, records = frame
+		lost = corrupted
+		if lastSequence is not None:
+			lost = (sequence - lastSequence - 1) & 0xff
+		lastSequence = sequence
+		corrupted = 0
+		yield sequence, records, lost
+
+def openPort():
+	import serial
+	# /dev/ttyUSB0 needs to be changed to the port the USART to USB adapter
+	# is plugged in to
+	port = sys.argv[1] if len(sys.argv) > 1 else "/dev/ttyUSB0"
+	baud = int(sys.argv[2]) if len(sys.argv) > 2 else 250000 # must match BAUD in the Makefile
+	ser = serial.Serial(port, baud)
+	ser.flushInput()
+	return ser
+
+if __name__ == "__main__":
+	for sequence, records, lost in readFrames(openPort()):
+		if lost:
+			print("lost {0} frame(s)".format(lost))
+		for recordType, payload in records:
+			print("[{0:<3}] {1}".format(sequence, formatRecord(recordType, payload)))
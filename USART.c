@@ -1,7 +1,7 @@
 /*
 
-   initUSART requires BAUDRATE to be defined in order to calculate
-     the bit-rate multiplier.  9600 is a reasonable default.
+   initUSART calculates the bit-rate multiplier for the baud rate it
+     is given.  9600 is a reasonable default.
 
   May not work with some of the older chips:
     Tiny2313, Mega8, Mega16, Mega32 have different pin macros
@@ -11,35 +11,303 @@
 */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdlib.h>
 #include "USART.h"
-#include <util/setbaud.h>
-
-void initUSART(void) 
-{                                /* requires BAUD */
-	UBRR0H = UBRRH_VALUE;                        /* defined in setbaud.h */
-	UBRR0L = UBRRL_VALUE;
-#if USE_2X
-	UCSR0A |= (1 << U2X0);
-#else
-	UCSR0A &= ~(1 << U2X0);
+
+#if (USART_TX_BUFFER_SIZE & (USART_TX_BUFFER_SIZE - 1)) || USART_TX_BUFFER_SIZE > 128
+#error "USART_TX_BUFFER_SIZE must be a power of 2, at most 128"
+#endif
+#define USART_TX_MASK  (USART_TX_BUFFER_SIZE - 1)
+#if (USART_RX_BUFFER_SIZE & (USART_RX_BUFFER_SIZE - 1)) || USART_RX_BUFFER_SIZE > 128
+#error "USART_RX_BUFFER_SIZE must be a power of 2, at most 128"
 #endif
-	/* Enable USART transmitter/receiver */
-	UCSR0B = (1 << TXEN0) | (1 << RXEN0);
+#define USART_RX_MASK  (USART_RX_BUFFER_SIZE - 1)
+
+/* The indices only ever count up, so head - tail is the number of
+   bytes queued. Bytes are added at head by the main program and
+   removed at tail by the interrupt */
+static volatile uint8_t txBuffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static volatile uint16_t txOverflows = 0;
+static volatile bool txSent = false;    /* a byte was sent since the last flush */
+
+/* Same again for receiving, bytes are added at head by the interrupt */
+static volatile uint8_t rxBuffer[USART_RX_BUFFER_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+static volatile uint16_t rxOverruns = 0;
+
+static int16_t baudError = 0;
+
+static bool queueBytes(const uint8_t[], uint8_t);
+static void sendNextByte(void);
+static uint16_t getBaudRegister(uint32_t, uint8_t);
+static uint32_t getActualBaud(uint16_t, uint8_t);
+static int16_t getBaudError(uint32_t, uint32_t);
+static void pollTransmit(void);
+static void receiveNextByte(void);
+static void pollReceive(void);
+static void printDecimal(uint16_t, uint8_t);
+
+uint32_t initUSART(uint32_t baud) 
+{
+	/* Normal mode divides the clock by 16, double speed mode by 8. Double
+	   speed reaches higher rates and sometimes gets closer to the baud
+	   rate, but samples each bit fewer times, so only use it if it helps */
+	uint16_t ubrr = getBaudRegister(baud, 16);
+	uint32_t actual = getActualBaud(ubrr, 16);
+	baudError = getBaudError(baud, actual);
+
+	uint16_t ubrr2x = getBaudRegister(baud, 8);
+	uint32_t actual2x = getActualBaud(ubrr2x, 8);
+	int16_t error2x = getBaudError(baud, actual2x);
+
+	if (abs(error2x) < abs(baudError))
+	{
+		ubrr = ubrr2x;
+		actual = actual2x;
+		baudError = error2x;
+		UCSR0A |= (1 << U2X0);
+	}
+	else
+	{
+		UCSR0A &= ~(1 << U2X0);
+	}
+	UBRR0H = ubrr >> 8;
+	UBRR0L = ubrr & 0xff;
+	/* Enable USART transmitter/receiver and the receive interrupt */
+	UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
 	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);   /* 8 data bits, 1 stop bit */
+	txHead = txTail = 0;
+	txSent = false;
+	rxHead = rxTail = 0;
+
+	return actual;
+}
+
+int16_t usartGetBaudError(void)
+{
+	return baudError;
+}
+
+/* Works out the bit-rate multiplier (UBRR0) closest to the baud rate,
+   divisor is 16 in normal mode or 8 in double speed mode */
+static uint16_t getBaudRegister(uint32_t baud, uint8_t divisor)
+{
+	if (baud == 0)
+		return 4095;
+	uint32_t ubrr = (F_CPU + (uint32_t) divisor * baud / 2) / ((uint32_t) divisor * baud);
+	if (ubrr == 0)                       /* faster than the USART can go */
+		return 0;
+	if (ubrr > 4096)                        /* UBRR0 only has 12 bits */
+		return 4095;
+	return ubrr - 1;
+}
+
+static uint32_t getActualBaud(uint16_t ubrr, uint8_t divisor)
+{
+	return F_CPU / ((uint32_t) divisor * (ubrr + 1));
+}
+
+/* Returns the error in hundredths of a percent */
+static int16_t getBaudError(uint32_t baud, uint32_t actual)
+{
+	if (baud == 0)
+		return INT16_MAX;
+	int64_t error = ((int64_t) actual - baud) * 10000 / baud;
+	if (error > INT16_MAX)
+		return INT16_MAX;
+	if (error < INT16_MIN)
+		return INT16_MIN;
+	return error;
 }
 
 
 void usartTransmitByte(uint8_t data) 
 {
-	/* Wait for empty transmit buffer */
-	loop_until_bit_is_set(UCSR0A, UDRE0);
-	UDR0 = data;                                            /* send data */
+	/* Wait for room in the transmit buffer */
+	while (!queueBytes(&data, 1))
+		pollTransmit();
+}
+
+bool usartTryTransmitByte(uint8_t data)
+{
+	return usartTryTransmit(&data, 1);
+}
+
+bool usartTryTransmit(const uint8_t data[], uint8_t length)
+{
+	if (queueBytes(data, length))
+		return true;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		txOverflows++;
+	}
+	return false;
+}
+
+uint8_t usartTransmitSpace(void)
+{
+	return USART_TX_BUFFER_SIZE - (uint8_t) (txHead - txTail);
+}
+
+uint16_t usartGetTransmitOverflowCount(void)
+{
+	uint16_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = txOverflows;
+		txOverflows = 0;
+	}
+	return count;
+}
+
+void usartFlush(void)
+{
+	while (txHead != txTail)
+		pollTransmit();
+	/* TXC0 is cleared each time a byte is loaded, so once it is set
+	   the last byte has been shifted out completely */
+	if (txSent)
+		loop_until_bit_is_set(UCSR0A, TXC0);
+	txSent = false;
+}
+
+/* Adds all of the bytes to the transmit buffer, or none of them if
+   they don't fit, and makes sure the interrupt is on to send them */
+static bool queueBytes(const uint8_t data[], uint8_t length)
+{
+	if (length > usartTransmitSpace())
+		return false;
+
+	/* Only this side writes txHead, the interrupt can only make more room */
+	uint8_t head = txHead;
+	for (uint8_t i = 0; i < length; i++)
+	{
+		txBuffer[head & USART_TX_MASK] = data[i];
+		head++;
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		txHead = head;
+		UCSR0B |= (1 << UDRIE0);          /* the interrupt sends the bytes */
+	}
+	return true;
+}
+
+/* Moves the next queued byte into the data register, and turns the
+   interrupt off once there are none left. The data register must be empty */
+static void sendNextByte(void)
+{
+	if (txHead == txTail)
+	{
+		UCSR0B &= ~(1 << UDRIE0);
+		return;
+	}
+
+	/* writing a 1 clears TXC0, the error flags must be written as 0 */
+	UCSR0A = (UCSR0A & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);
+	UDR0 = txBuffer[txTail & USART_TX_MASK];
+	txTail++;
+	txSent = true;
+}
+
+/* Lets the queue drain while waiting. With global interrupts disabled
+   (e.g. called from another interrupt) the interrupt can't run, so the
+   bytes are sent from here instead */
+static void pollTransmit(void)
+{
+	if (bit_is_set(SREG, SREG_I))
+		return;
+	if (bit_is_set(UCSR0A, UDRE0))
+		sendNextByte();
+}
+
+ISR(USART_UDRE_vect)
+{
+	sendNextByte();
 }
 
 uint8_t usartReceiveByte(void) 
 {
-	loop_until_bit_is_set(UCSR0A, RXC0);       /* Wait for incoming data */
-	return UDR0;                                /* return register value */
+	uint8_t data;
+	while (!usartTryReceiveByte(&data))          /* Wait for incoming data */
+		pollReceive();
+	return data;
+}
+
+bool usartTryReceiveByte(uint8_t *data)
+{
+	if (!usartPeekByte(data))
+		return false;
+
+	rxTail++;            /* only this side writes rxTail, making more room */
+	return true;
+}
+
+bool usartPeekByte(uint8_t *data)
+{
+	if (rxHead == rxTail)
+		return false;
+
+	*data = rxBuffer[rxTail & USART_RX_MASK];
+	return true;
+}
+
+uint8_t usartReceiveAvailable(void)
+{
+	return (uint8_t) (rxHead - rxTail);
+}
+
+uint16_t usartGetReceiveOverrunCount(void)
+{
+	uint16_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = rxOverruns;
+		rxOverruns = 0;
+	}
+	return count;
+}
+
+/* Moves a received byte into the receive buffer. A byte that doesn't
+   fit is dropped, as is any byte the hardware itself had to drop
+   (DOR0), and both are counted as overruns */
+static void receiveNextByte(void)
+{
+	/* the flags must be read before UDR0, reading it moves them on */
+	if (bit_is_set(UCSR0A, DOR0))
+		rxOverruns++;
+
+	uint8_t data = UDR0;
+	if ((uint8_t) (rxHead - rxTail) == USART_RX_BUFFER_SIZE)
+	{
+		rxOverruns++;
+		return;
+	}
+
+	rxBuffer[rxHead & USART_RX_MASK] = data;
+	rxHead++;
+}
+
+/* Receives while waiting with global interrupts disabled, when the
+   interrupt can't run */
+static void pollReceive(void)
+{
+	if (bit_is_set(SREG, SREG_I))
+		return;
+	if (bit_is_set(UCSR0A, RXC0))
+		receiveNextByte();
+}
+
+ISR(USART_RX_vect)
+{
+	receiveNextByte();
 }
 
 void usartPrintString(const char myString[]) 
@@ -59,7 +327,7 @@ void usartReadString(char myString[], uint8_t maxLength)
 	i = 0;
 	while (i < (maxLength - 1)) 
 	{                   /* prevent over-runs */
-		response = receiveByte();
+		response = usartReceiveByte();
 		usartTransmitByte(response);                                    /* echo */
 		if (response == '\r') 
 		{                     /* enter marks the end */
@@ -77,18 +345,31 @@ void usartReadString(char myString[], uint8_t maxLength)
 void usartPrintByte(uint8_t byte) 
 {
     /* Converts a byte to a string of decimal text, sends it */
-	usartTransmitByte('0' + (byte / 100));                        /* Hundreds */
-	usartTransmitByte('0' + ((byte / 10) % 10));                      /* Tens */
-	usartTransmitByte('0' + (byte % 10));                             /* Ones */
+	printDecimal(byte, 3);
 }
 
 void usartPrintWord(uint16_t word) 
 {
-	usartTransmitByte('0' + (word / 10000));                 /* Ten-thousands */
-	usartTransmitByte('0' + ((word / 1000) % 10));               /* Thousands */
-	usartTransmitByte('0' + ((word / 100) % 10));                 /* Hundreds */
-	usartTransmitByte('0' + ((word / 10) % 10));                      /* Tens */
-	usartTransmitByte('0' + (word % 10));                             /* Ones */
+	printDecimal(word, 5);
+}
+
+/* Sends the last few decimal digits of a number, leading zeros included.
+   The AVR has no divide instruction, so each digit is found by counting
+   how many times its power of ten can be subtracted instead */
+static void printDecimal(uint16_t value, uint8_t digits)
+{
+	static const uint16_t powersOfTen[] = { 10000, 1000, 100, 10, 1 };
+
+	for (uint8_t i = 5 - digits; i < 5; i++)
+	{
+		char digit = '0';
+		while (value >= powersOfTen[i])
+		{
+			value -= powersOfTen[i];
+			digit++;
+		}
+		usartTransmitByte(digit);
+	}
 }
 
 void usartPrintBinaryByte(uint8_t byte) 
@@ -118,9 +399,9 @@ void usartPrintHexByte(uint8_t byte)
 	/* Prints a byte as its hexadecimal equivalent */
 	uint8_t nibble;
 	nibble = (byte & 0b11110000) >> 4;
-	usartTransmitByte(nibbleToHexCharacter(nibble));
+	usartTransmitByte(usartNibbleToHexCharacter(nibble));
 	nibble = byte & 0b00001111;
-	usartTransmitByte(nibbleToHexCharacter(nibble));
+	usartTransmitByte(usartNibbleToHexCharacter(nibble));
 }
 
 uint8_t usartGetNumber(void) 
@@ -2,33 +2,91 @@
 #define GUARD_USART_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* Functions to initialize, send, receive over USART
 
-   initUSART requires BAUD to be defined in order to calculate
-     the bit-rate multiplier.
+   initUSART calculates the bit-rate multiplier for any baud rate
+     from F_CPU. BAUD is the rate set in the Makefile.
  */
 
 #ifndef BAUD                          /* if not defined in Makefile... */
 #define BAUD  9600                     /* set a safe default baud rate */
+#endif
+
+/* Rates further than this from the requested baud rate, in hundredths
+   of a percent, are unlikely to work. Compare usartGetBaudError() to it */
+#define USART_MAX_BAUD_ERROR  200
+
+/* Bytes waiting to be sent are kept in a ring buffer and sent by the
+   USART data register empty interrupt. Must be a power of 2, at most 128 */
+#ifndef USART_TX_BUFFER_SIZE
+#define USART_TX_BUFFER_SIZE  64
+#endif
+
+/* Received bytes are stored by the receive complete interrupt until
+   they are read. Must be a power of 2, at most 128 */
+#ifndef USART_RX_BUFFER_SIZE
+#define USART_RX_BUFFER_SIZE  32
 #endif
 
                                   /* These are defined for convenience */
-#define   USART_HAS_DATA   bit_is_set(UCSR0A, RXC0)
+#define   USART_HAS_DATA   (usartReceiveAvailable() != 0)
 #define   USART_READY      bit_is_set(UCSR0A, UDRE0)
 
-/* Takes the defined BAUD and F_CPU,
-   calculates the bit-clock multiplier,
-   and configures the hardware USART                   */
-void initUSART(void);
+/* Takes the baud rate and F_CPU, calculates the bit-clock multiplier,
+   choosing double speed (U2X) mode when it gets closer to the baud rate,
+   and configures the hardware USART.
+   Returns the baud rate actually used, e.g. initUSART(BAUD) */
+uint32_t initUSART(uint32_t baud);
+
+/* Returns how far the rate set by initUSART is from the requested
+   baud rate, in hundredths of a percent, e.g. -350 for -3.5% */
+int16_t usartGetBaudError(void);
 
-/* Blocking transmit and receive functions.
-   When you call receiveByte() your program will hang until
-   data comes through.  We'll improve on this later. */
+/* Queues a byte to be sent in the background. Only waits if the
+   transmit buffer is full. Global interrupts must be enabled for the
+   buffer to drain, with them disabled the bytes are sent by polling */
 void usartTransmitByte(uint8_t data);
 
-/* reads a byte from the serial input */
-uint8_t usartReceiveByte();
+/* Queues a byte without ever waiting.
+   Returns false (and counts an overflow) if the transmit buffer is full */
+bool usartTryTransmitByte(uint8_t data);
+
+/* Queues all of the bytes without ever waiting, or none of them.
+   Returns false (and counts an overflow) if they don't fit */
+bool usartTryTransmit(const uint8_t data[], uint8_t length);
+
+/* Returns the number of bytes that can be queued without waiting */
+uint8_t usartTransmitSpace(void);
+
+/* Returns the number of bytes refused by the usartTry functions
+   since the last call */
+uint16_t usartGetTransmitOverflowCount(void);
+
+/* Waits until every queued byte has been sent, including the stop bit
+   of the last one. Use it before sleeping, as the USART clock stops in
+   power down, or before shutting the USART down */
+void usartFlush(void);
+
+/* Reads a byte from the serial input. Bytes are received in the
+   background, but when none are waiting your program will hang until
+   data comes through. */
+uint8_t usartReceiveByte(void);
+
+/* Reads a received byte without ever waiting.
+   Returns false if nothing has been received */
+bool usartTryReceiveByte(uint8_t *data);
+
+/* Like usartTryReceiveByte, but leaves the byte to be read again */
+bool usartPeekByte(uint8_t *data);
+
+/* Returns the number of received bytes waiting to be read */
+uint8_t usartReceiveAvailable(void);
+
+/* Returns the number of received bytes lost since the last call,
+   because the receive buffer was full or the interrupt ran too late */
+uint16_t usartGetReceiveOverrunCount(void);
 
 /* Utility function to transmit an entire string from RAM */
 void usartPrintString(const char myString[]);
@@ -46,7 +104,8 @@ void usartPrintWord(uint16_t word);
 /* Prints a byte out in 1s and 0s */
 void usartPrintBinaryByte(uint8_t byte);
 
-char usartNibbleToHex(uint8_t nibble);
+/* Converts 4 bits into a hexadecimal character */
+char usartNibbleToHexCharacter(uint8_t nibble);
 
 /* Prints a byte out in hexadecimal */
 void usartPrintHexByte(uint8_t byte);
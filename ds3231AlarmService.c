@@ -0,0 +1,119 @@
+#include "ds3231AlarmService.h"
+#include "sqwInterrupt.h"
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+// the callback of each alarm, NULL if none
+static ds3231_alarm_callback_t callbacks[ALARM_NUMBER_T_MAX];
+// set by the pin change interrupt when the ds3231 pulls INT/SQW low
+static volatile bool alarmPending = false;
+
+static void onSqwEdge(bool);
+
+/*
+   starts handling ds3231 alarms through the INT/SQW pin change interrupt instead of polling
+   the pin. Alarms are still set with `ds3231SetAlarm`, which also selects the interrupt output
+   (INTCN) of the INT/SQW pin. Global interrupts must be enabled
+*/
+void ds3231AlarmServiceStart(void)
+{
+	initSqwInterrupt();
+	sqwAddHandler(onSqwEdge);
+
+	// an alarm may already be holding the pin low, that won't cause a pin change
+	if(!sqwIsHigh())
+		alarmPending = true;
+}
+
+/*
+   stops handling ds3231 alarms, the alarms themselves are left set
+*/
+void ds3231AlarmServiceStop(void)
+{
+	sqwRemoveHandler(onSqwEdge);
+	alarmPending = false;
+}
+
+/*
+   sets the function run by `ds3231AlarmServiceRun` when an alarm triggers
+	Param: alarm -> the alarm, e.g. ALARM_1
+		   callback -> the function to run, NULL for none (the alarm flag is still cleared)
+*/
+void ds3231OnAlarm(alarm_number_t alarm, ds3231_alarm_callback_t callback)
+{
+	if(alarm < ALARM_NUMBER_T_MAX)
+		callbacks[alarm] = callback;
+}
+
+/*
+	Returns: true if an alarm has triggered and `ds3231AlarmServiceRun` has not handled it yet
+*/
+bool ds3231AlarmIsPending(void)
+{
+	return alarmPending;
+}
+
+/*
+   handles triggered alarms. Does nothing (and uses no bus time) unless the INT/SQW pin has
+   gone low, otherwise the alarm flags are read and cleared with a single read and write and
+   the callback of every triggered alarm is run
+	Returns: a bitmask of the alarms handled, DS3231_STATUS_A1F_BIT and/or DS3231_STATUS_A2F_BIT
+*/
+uint8_t ds3231AlarmServiceRun(void)
+{
+	if(!alarmPending)
+		return 0;
+
+	alarmPending = false;
+	uint8_t flags = ds3231ClearAlarmFlags();
+
+	if((flags & DS3231_STATUS_A1F_BIT) && callbacks[ALARM_1] != NULL)
+		callbacks[ALARM_1](ALARM_1);
+	if((flags & DS3231_STATUS_A2F_BIT) && callbacks[ALARM_2] != NULL)
+		callbacks[ALARM_2](ALARM_2);
+
+	// the pin is released once the flags are clear, if it is still low an alarm triggered again
+	if(!sqwIsHigh())
+		alarmPending = true;
+
+	return flags;
+}
+
+/*
+   puts the AVR to sleep until an interrupt happens, then handles any triggered alarms. The
+   sleep is skipped if an alarm is already pending or interrupt driven I2C transactions are
+   still running on the ds3231's bus. In SLEEP_MODE_PWR_DOWN only external interrupts (such as the INT/SQW pin
+   change) wake the AVR, and peripheral clocks stop, so wait for anything being sent over
+   the USART to finish first
+	Param: sleepMode -> the avr/sleep.h mode to use, e.g. SLEEP_MODE_PWR_DOWN
+	Returns: a bitmask of the alarms handled, see `ds3231AlarmServiceRun`
+*/
+uint8_t ds3231AlarmServiceSleep(uint8_t sleepMode)
+{
+	set_sleep_mode(sleepMode);
+
+	cli();
+	if(!alarmPending && !ds3231IsBusy())
+	{
+		sleep_enable();
+		sei(); // the instruction after sei always runs, so a wake up interrupt can't be missed
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+
+	return ds3231AlarmServiceRun();
+}
+
+/*
+   pin change handler, the ds3231 pulls INT/SQW low when an enabled alarm triggers
+	Param: isHigh -> the new level of the INT/SQW pin
+*/
+static void onSqwEdge(bool isHigh)
+{
+	if(!isHigh)
+		alarmPending = true;
+}
@@ -0,0 +1,23 @@
+#ifndef GUARD_DS3231_ALARM_SERVICE_H
+#define GUARD_DS3231_ALARM_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "DS3231.h"
+
+// called from the main loop (not from an interrupt) when an alarm has triggered, so it may use the I2C bus
+typedef void (*ds3231_alarm_callback_t)(alarm_number_t);
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+void ds3231AlarmServiceStart(void);
+void ds3231AlarmServiceStop(void);
+void ds3231OnAlarm(alarm_number_t, ds3231_alarm_callback_t);
+
+bool ds3231AlarmIsPending(void);
+uint8_t ds3231AlarmServiceRun(void);
+uint8_t ds3231AlarmServiceSleep(uint8_t);
+
+#endif
@@ -0,0 +1,234 @@
+#include "ds3231Clock.h"
+#include "sqwInterrupt.h"
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+// the local copy of the ds3231 date and time, advanced by the 1 Hz square wave
+static datetime_t clock;
+// true if the HOURS register was in 12 hour mode when the clock was last synced
+static bool clockIs12Hour = false;
+// false until the first successful read of the ds3231
+static volatile bool clockSynced = false;
+// counts every second boundary, used to detect a tick during a resync read
+static volatile uint8_t tickCount = 0;
+// seconds since the clock was last read from the ds3231
+static volatile uint16_t secondsSinceSync = 0;
+// seconds between resyncs, 0 = never
+static uint16_t resyncInterval = DS3231_CLOCK_RESYNC_INTERVAL;
+
+static const uint8_t daysInMonth[MONTH_T_MAX] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static void onSqwEdge(bool);
+static void advanceSecond(void);
+static uint8_t resync(void);
+
+/*
+   starts the software clock. The ds3231 is set to output a 1 Hz square wave on its INT/SQW
+   pin, the local clock is loaded with a single burst read and from then on it is advanced by
+   the pin change interrupt, so reading the time never touches the I2C bus. Global interrupts
+   must be enabled.
+
+   Note: the square wave clears INTCN, so while the clock runs the ds3231 alarms no longer
+   drive the INT/SQW pin (their flags are still set in the STATUS register)
+	Param: interval -> seconds between re-reads of the ds3231 (see `ds3231ClockService`),
+					   0 only reads it now
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the square wave could not be enabled
+			 2 if the ds3231 could not be read, `ds3231ClockService` keeps retrying
+*/
+uint8_t ds3231ClockStart(uint16_t interval)
+{
+	resyncInterval = interval;
+	clockSynced = false;
+
+	if(ds3231EnableBBSQW(HZ_1) != DS3231_OPERATION_SUCCESS)
+		return 1;
+
+	initSqwInterrupt();
+	sqwAddHandler(onSqwEdge);
+
+	// a second boundary during the read makes it retry, that can't happen twice in a row
+	uint8_t result = resync();
+	if(result == 3)
+		result = resync();
+
+	return result == DS3231_OPERATION_SUCCESS ? DS3231_OPERATION_SUCCESS : 2;
+}
+
+/*
+   stops advancing the software clock. The ds3231 keeps outputting the square wave
+*/
+void ds3231ClockStop(void)
+{
+	sqwRemoveHandler(onSqwEdge);
+	clockSynced = false;
+}
+
+/*
+   call regularly from the main loop. Re-reads the ds3231 with a single burst once the resync
+   interval has passed, or straight away if the clock has never been read successfully.
+   Does nothing (and uses no bus time) otherwise
+	Returns: DS3231_OPERATION_SUCCESS (0) on success or if no resync was due
+			 2 if the ds3231 could not be read
+			 3 if a second boundary happened during the read, the resync is retried on the next call
+*/
+uint8_t ds3231ClockService(void)
+{
+	uint16_t elapsed;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		elapsed = secondsSinceSync;
+	}
+
+	if(clockSynced && (resyncInterval == 0 || elapsed < resyncInterval))
+		return DS3231_OPERATION_SUCCESS;
+
+	return resync();
+}
+
+/*
+	Returns: true once the software clock holds a valid date and time
+*/
+bool ds3231ClockIsSynced(void)
+{
+	return clockSynced;
+}
+
+/*
+   gets the date and time from the software clock without any bus traffic
+	Param: dateTime -> the struct the date and time will be stored in
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the clock has not been synced with the ds3231 yet
+*/
+uint8_t ds3231ClockGetDateTime(datetime_t *dateTime)
+{
+	if(!clockSynced)
+		return 1;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*dateTime = clock;
+	}
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+	Returns: the seconds value of the software clock, without any bus traffic
+*/
+uint8_t ds3231ClockGetSecond(void)
+{
+	return clock.second;
+}
+
+/*
+   reads the date and time from the ds3231 in a single burst and loads it into the clock.
+   The read is thrown away if a second boundary happened while it was in progress, as it
+   can't be known whether the registers were read before or after they changed
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 2 if the ds3231 could not be read
+			 3 if a second boundary happened during the read
+*/
+static uint8_t resync(void)
+{
+	uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+	datetime_t dateTime;
+	uint8_t ticks = tickCount;
+
+	if(getRegisterValues(DS3231_REGISTER_SECONDS, registers, DS3231_DATETIME_REGISTER_COUNT) != DS3231_OPERATION_SUCCESS)
+		return 2;
+	ds3231DecodeDateTime(registers, &dateTime);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if(tickCount != ticks)
+			return 3;
+
+		clock = dateTime;
+		clockIs12Hour = registers[DS3231_REGISTER_HOURS] & DS3231_HOUR_MODE_12_BIT;
+		secondsSinceSync = 0;
+		clockSynced = true;
+	}
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   pin change handler, the ds3231 increments its seconds register on the falling edge of
+   the 1 Hz square wave
+	Param: isHigh -> the new level of the INT/SQW pin
+*/
+static void onSqwEdge(bool isHigh)
+{
+	if(isHigh)
+		return;
+
+	tickCount++;
+	if(!clockSynced)
+		return;
+
+	advanceSecond();
+	if(secondsSinceSync != UINT16_MAX)
+		secondsSinceSync++;
+}
+
+/*
+   moves the local clock on by one second, rolling over the minutes, hours, day, date,
+   month, year and century the same way the ds3231 does (every year divisible by 4 is a leap year)
+*/
+static void advanceSecond(void)
+{
+	if(++clock.second < 60)
+		return;
+	clock.second = 0;
+
+	if(++clock.minute < 60)
+		return;
+	clock.minute = 0;
+
+	if(clockIs12Hour)
+	{
+		if(clock.hour == 12) // 12:59 -> 1:00, AM/PM unchanged
+		{
+			clock.hour = 1;
+			return;
+		}
+
+		if(++clock.hour < 12)
+			return;
+
+		clock.isPM = !clock.isPM; // 11:59 -> 12:00
+		if(clock.isPM) // noon
+			return;
+	}
+	else
+	{
+		if(++clock.hour < 24)
+			return;
+		clock.hour = 0;
+	}
+
+	clock.day = clock.day == SATURDAY ? SUNDAY : (day_t) (clock.day + 1);
+
+	uint8_t monthLength = daysInMonth[clock.month];
+	if(clock.month == FEBRUARY && clock.year % 4 == 0)
+		monthLength++;
+
+	if(++clock.date <= monthLength)
+		return;
+	clock.date = 1;
+
+	if(clock.month != DECEMBER)
+	{
+		clock.month = (month_t) (clock.month + 1);
+		return;
+	}
+	clock.month = JANUARY;
+
+	if(++clock.year < 100)
+		return;
+	clock.year = 0;
+	clock.century++;
+}
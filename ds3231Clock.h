@@ -0,0 +1,25 @@
+#ifndef GUARD_DS3231_CLOCK_H
+#define GUARD_DS3231_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "DS3231.h"
+
+// default number of seconds between re-reads of the ds3231, 0 only reads it when the clock starts
+#ifndef DS3231_CLOCK_RESYNC_INTERVAL
+#define DS3231_CLOCK_RESYNC_INTERVAL 3600
+#endif
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t ds3231ClockStart(uint16_t);
+void ds3231ClockStop(void);
+uint8_t ds3231ClockService(void);
+
+bool ds3231ClockIsSynced(void);
+uint8_t ds3231ClockGetDateTime(datetime_t *);
+uint8_t ds3231ClockGetSecond(void);
+
+#endif
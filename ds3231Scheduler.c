@@ -0,0 +1,382 @@
+#include "ds3231Scheduler.h"
+
+#include <stddef.h>
+
+#if DS3231_SCHEDULER_CAPACITY > 32
+#error "DS3231_SCHEDULER_CAPACITY must be 32 or less"
+#endif
+
+// the ds3231 alarm registers are written this many seconds ahead at the least, so the
+// seconds can't tick past the alarm time while it is being written
+#define DS3231_SCHEDULER_MIN_LEAD 2
+
+// min-heap of the scheduled jobs ordered by deadline, jobs[0] is always the next one due
+static ds3231_job_t jobs[DS3231_SCHEDULER_CAPACITY];
+static uint8_t jobCount = 0;
+static uint32_t usedIds = 0; // bit n set if id n belongs to a scheduled job
+// the time ALARM_1 is currently set for, only valid if alarmArmed is true
+static uint32_t armedTime = 0;
+static bool alarmArmed = false;
+
+static uint8_t getNow(uint32_t *);
+static uint8_t addJob(uint32_t, uint32_t, ds3231_job_callback_t, uint8_t *);
+static void removeJob(uint8_t);
+static void siftUp(uint8_t);
+static void siftDown(uint8_t);
+static void swapJobs(uint8_t, uint8_t);
+static uint8_t armAlarm(uint32_t);
+static uint8_t rearm(void);
+static void onAlarm(alarm_number_t);
+
+/*
+   starts the scheduler. Any number of jobs (up to DS3231_SCHEDULER_CAPACITY) share ALARM_1,
+   which is always set for the earliest deadline, so the AVR only wakes when a job is due.
+   The alarm service is started as well, so jobs run from `ds3231AlarmServiceRun` or
+   `ds3231AlarmServiceSleep` in the main loop. ALARM_2 can optionally provide a tick at the
+   start of every minute. The ds3231 must be in 24 hour mode
+	Param: minuteTick -> run at the start of every minute using ALARM_2, NULL to leave ALARM_2 free
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if 12 hour mode is selected
+			 2 if ALARM_2 could not be set
+			 3 if the time could not be read from the ds3231
+*/
+uint8_t ds3231SchedulerStart(ds3231_alarm_callback_t minuteTick)
+{
+	if(ds3231Is12HourMode())
+		return 1;
+
+	ds3231OnAlarm(ALARM_1, onAlarm);
+	ds3231AlarmServiceStart();
+
+	if(minuteTick != NULL)
+	{
+		alarm_t alarm = { .alarmNumber = ALARM_2, .trigger = A2_EVERY_MIN };
+		if(ds3231SetAlarm(&alarm) != DS3231_OPERATION_SUCCESS)
+			return 2;
+		ds3231OnAlarm(ALARM_2, minuteTick);
+	}
+
+	return rearm();
+}
+
+/*
+   schedules a job to run at an absolute time
+	Param: deadline -> when to run the job, in seconds since 2000-01-01 00:00:00 (see
+					   `ds3231DateTimeToSeconds`). A time in the past, or less than
+					   DS3231_SCHEDULER_MIN_LEAD seconds away, runs the job DS3231_SCHEDULER_MIN_LEAD
+					   seconds from now, when ALARM_1 triggers
+		   period -> seconds between runs for a repeating job, 0 to run it once
+		   callback -> the function to run
+		   id -> set to the id of the job, which is also passed to the callback. May be NULL
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if DS3231_SCHEDULER_CAPACITY jobs are already scheduled
+			 2 if the callback is NULL
+			 3 if the time could not be read from the ds3231, the job is still scheduled
+*/
+uint8_t ds3231ScheduleAt(uint32_t deadline, uint32_t period, ds3231_job_callback_t callback, uint8_t *id)
+{
+	uint8_t newId;
+	uint8_t error = addJob(deadline, period, callback, &newId);
+	if(error)
+		return error;
+
+	if(id != NULL)
+		*id = newId;
+
+	if(jobs[0].id != newId) // ALARM_1 is already set for an earlier job
+		return DS3231_OPERATION_SUCCESS;
+
+	return rearm();
+}
+
+/*
+   schedules a job to run a number of seconds from now, see `ds3231ScheduleAt`
+	Param: delay -> seconds from now to run the job
+		   period -> seconds between runs for a repeating job, 0 to run it once
+		   callback -> the function to run
+		   id -> set to the id of the job. May be NULL
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if DS3231_SCHEDULER_CAPACITY jobs are already scheduled
+			 2 if the callback is NULL
+			 3 if the time could not be read from the ds3231, the job is not scheduled
+*/
+uint8_t ds3231ScheduleIn(uint32_t delay, uint32_t period, ds3231_job_callback_t callback, uint8_t *id)
+{
+	uint32_t now;
+	if(getNow(&now) != DS3231_OPERATION_SUCCESS)
+		return 3;
+
+	uint8_t newId;
+	uint8_t error = addJob(now + delay, period, callback, &newId);
+	if(error)
+		return error;
+
+	if(id != NULL)
+		*id = newId;
+
+	if(jobs[0].id != newId)
+		return DS3231_OPERATION_SUCCESS;
+
+	return armAlarm(now);
+}
+
+/*
+   removes a scheduled job. A job may remove itself from its own callback
+	Param: id -> the id of the job
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if no job has the id
+			 3 if the time could not be read from the ds3231 to move ALARM_1
+*/
+uint8_t ds3231Unschedule(uint8_t id)
+{
+	for(uint8_t i = 0; i < jobCount; i++)
+	{
+		if(jobs[i].id != id)
+			continue;
+
+		removeJob(i);
+		if(i == 0) // the job ALARM_1 was set for
+			return rearm();
+
+		return DS3231_OPERATION_SUCCESS;
+	}
+
+	return 1;
+}
+
+/*
+	Returns: the number of jobs scheduled
+*/
+uint8_t ds3231SchedulerJobCount(void)
+{
+	return jobCount;
+}
+
+/*
+   runs every job that is due and sets ALARM_1 for the next one. Called automatically when
+   ALARM_1 triggers. As ALARM_1 only matches the date and time of the month, a deadline more
+   than a month away makes it trigger early, in which case nothing runs and it is set again
+	Returns: the number of jobs run
+*/
+uint8_t ds3231SchedulerRun(void)
+{
+	uint8_t ran = 0;
+	uint32_t now;
+
+	if(getNow(&now) != DS3231_OPERATION_SUCCESS)
+		return 0;
+
+	// jobs may take long enough for the next one to become due, check the time again after them
+	for(uint8_t pass = 0; pass < 4; pass++)
+	{
+		if(jobCount == 0 || jobs[0].deadline > now)
+			break;
+
+		while(jobCount != 0 && jobs[0].deadline <= now)
+		{
+			ds3231_job_t job = jobs[0];
+
+			// the job is moved or removed before its callback runs, so the callback may
+			// reschedule or remove it
+			if(job.period)
+			{
+				uint32_t next = job.deadline + job.period;
+				if(next <= now) // missed runs are skipped rather than run back to back
+					next += ((now - next) / job.period + 1) * job.period;
+				jobs[0].deadline = next;
+				siftDown(0);
+			}
+			else
+			{
+				removeJob(0);
+			}
+
+			job.callback(job.id);
+			ran++;
+		}
+
+		if(getNow(&now) != DS3231_OPERATION_SUCCESS)
+			return ran;
+	}
+
+	armAlarm(now);
+	return ran;
+}
+
+/*
+   reads the current time from the ds3231
+	Param: now -> set to the seconds since 2000-01-01 00:00:00
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 3 if the time could not be read
+*/
+static uint8_t getNow(uint32_t *now)
+{
+	datetime_t dateTime;
+	if(ds3231GetDateTime(&dateTime) != DS3231_OPERATION_SUCCESS)
+		return 3;
+
+	*now = ds3231DateTimeToSeconds(&dateTime);
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   adds a job to the heap with the lowest free id
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the heap is full
+			 2 if the callback is NULL
+*/
+static uint8_t addJob(uint32_t deadline, uint32_t period, ds3231_job_callback_t callback, uint8_t *id)
+{
+	if(jobCount == DS3231_SCHEDULER_CAPACITY)
+		return 1;
+	if(callback == NULL)
+		return 2;
+
+	uint8_t newId = 0;
+	while(usedIds & ((uint32_t) 1 << newId))
+		newId++;
+	usedIds |= (uint32_t) 1 << newId;
+
+	jobs[jobCount].deadline = deadline;
+	jobs[jobCount].period = period;
+	jobs[jobCount].callback = callback;
+	jobs[jobCount].id = newId;
+	siftUp(jobCount++);
+
+	*id = newId;
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   removes the job at a position in the heap and frees its id
+*/
+static void removeJob(uint8_t index)
+{
+	usedIds &= ~((uint32_t) 1 << jobs[index].id);
+
+	jobCount--;
+	if(index == jobCount)
+		return;
+
+	// fill the hole with the last job, which may need to move either way
+	jobs[index] = jobs[jobCount];
+	siftUp(index);
+	siftDown(index);
+}
+
+static void siftUp(uint8_t index)
+{
+	while(index > 0)
+	{
+		uint8_t parent = (index - 1) / 2;
+		if(jobs[parent].deadline <= jobs[index].deadline)
+			break;
+
+		swapJobs(parent, index);
+		index = parent;
+	}
+}
+
+static void siftDown(uint8_t index)
+{
+	while(1)
+	{
+		uint8_t smallest = index;
+		uint8_t left = 2 * index + 1;
+		uint8_t right = left + 1;
+
+		if(left < jobCount && jobs[left].deadline < jobs[smallest].deadline)
+			smallest = left;
+		if(right < jobCount && jobs[right].deadline < jobs[smallest].deadline)
+			smallest = right;
+		if(smallest == index)
+			break;
+
+		swapJobs(smallest, index);
+		index = smallest;
+	}
+}
+
+static void swapJobs(uint8_t a, uint8_t b)
+{
+	ds3231_job_t job = jobs[a];
+	jobs[a] = jobs[b];
+	jobs[b] = job;
+}
+
+/*
+   sets ALARM_1 for the earliest deadline, or removes it if no jobs are left. A deadline less
+   than DS3231_SCHEDULER_MIN_LEAD seconds away (or already passed) is set that far ahead
+   instead, so it can't be missed. Nothing is written if ALARM_1 is already set correctly
+	Param: now -> the current time in seconds since 2000-01-01 00:00:00
+	Returns: DS3231_OPERATION_SUCCESS (0), or the error of `ds3231SetAlarm` or `ds3231RemoveAlarm`.
+			 ALARM_1 is only taken as set or removed once the ds3231 has accepted it
+*/
+static uint8_t armAlarm(uint32_t now)
+{
+	if(jobCount == 0)
+	{
+		if(alarmArmed)
+		{
+			uint8_t error = ds3231RemoveAlarm(ALARM_1);
+			if(error)
+				return error;
+		}
+		alarmArmed = false;
+		return DS3231_OPERATION_SUCCESS;
+	}
+
+	uint32_t target = jobs[0].deadline;
+	if(target < now + DS3231_SCHEDULER_MIN_LEAD)
+	{
+		// an alarm that is about to trigger will run the job just as well
+		if(alarmArmed && armedTime > now && armedTime <= now + DS3231_SCHEDULER_MIN_LEAD)
+			return DS3231_OPERATION_SUCCESS;
+		target = now + DS3231_SCHEDULER_MIN_LEAD;
+	}
+
+	if(alarmArmed && armedTime == target)
+		return DS3231_OPERATION_SUCCESS;
+
+	datetime_t dateTime;
+	ds3231SecondsToDateTime(target, &dateTime);
+
+	alarm_t alarm =
+	{
+		.alarmNumber = ALARM_1,
+		.second = dateTime.second,
+		.minute = dateTime.minute,
+		.hour = dateTime.hour,
+		.useDay = false,
+		.dayDate = dateTime.date,
+		.trigger = A1_DAY_DATE_HOUR_MIN_SEC_MATCH
+	};
+
+	uint8_t error = ds3231SetAlarm(&alarm);
+	alarmArmed = error == DS3231_OPERATION_SUCCESS;
+	armedTime = target;
+
+	return error;
+}
+
+/*
+   reads the time and sets ALARM_1 for the earliest deadline
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 3 if the time could not be read from the ds3231
+*/
+static uint8_t rearm(void)
+{
+	uint32_t now;
+	if(getNow(&now) != DS3231_OPERATION_SUCCESS)
+		return 3;
+
+	return armAlarm(now);
+}
+
+/*
+   ALARM_1 callback of the alarm service
+*/
+static void onAlarm(alarm_number_t alarm)
+{
+	ds3231SchedulerRun();
+}
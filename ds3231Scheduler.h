@@ -0,0 +1,39 @@
+#ifndef GUARD_DS3231_SCHEDULER_H
+#define GUARD_DS3231_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "DS3231.h"
+#include "ds3231AlarmService.h"
+
+// the most jobs that can be scheduled at the same time (at most 32)
+#ifndef DS3231_SCHEDULER_CAPACITY
+#define DS3231_SCHEDULER_CAPACITY 8
+#endif
+
+#define DS3231_SCHEDULER_INVALID_ID 0xff
+
+// called from the main loop when a job is due, with the id returned when it was scheduled
+typedef void (*ds3231_job_callback_t)(uint8_t id);
+
+// a scheduled job, times are in seconds since 2000-01-01 00:00:00 (see ds3231DateTimeToSeconds)
+typedef struct
+{
+	uint32_t deadline; // when the job is next due
+	uint32_t period; // seconds between runs for a repeating job, 0 for a job that runs once
+	ds3231_job_callback_t callback;
+	uint8_t id;
+} ds3231_job_t;
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t ds3231SchedulerStart(ds3231_alarm_callback_t);
+uint8_t ds3231ScheduleAt(uint32_t, uint32_t, ds3231_job_callback_t, uint8_t *);
+uint8_t ds3231ScheduleIn(uint32_t, uint32_t, ds3231_job_callback_t, uint8_t *);
+uint8_t ds3231Unschedule(uint8_t);
+uint8_t ds3231SchedulerJobCount(void);
+uint8_t ds3231SchedulerRun(void);
+
+#endif
@@ -0,0 +1,178 @@
+#include "ds3231Timestamp.h"
+#include "DS3231.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+// number of times TCNT1 has wrapped, the upper bits of the tick counter
+static volatile uint32_t overflowCount = 0;
+// the tick count captured at the last second boundary (falling edge of the 1 Hz square wave)
+static volatile uint64_t secondTicks = 0;
+// the number of second boundaries seen since the counter was started
+static volatile uint32_t secondCount = 0;
+
+static uint64_t combineTicks(uint16_t);
+static void captureSecond(void);
+static void catchUp(void);
+
+/*
+   starts the tick counter. The ds3231 32KHz output clocks Timer1 through its external clock
+   input T1 (PD5), so a tick is 1 / 32768 s (~30.5 us), and the 1 Hz square wave on ICP1 (PB0)
+   captures the tick count at every second boundary. Both ds3231 outputs are open drain, so
+   the pull-ups of both pins are enabled. Timer1 is used exclusively, global interrupts must
+   be enabled. Reading the counter never touches the I2C bus.
+
+   Note: the 1 Hz square wave clears INTCN, so alarms no longer drive the INT/SQW pin
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 1 if the ds3231 outputs could not be enabled
+*/
+uint8_t ds3231TimestampStart(void)
+{
+	if(ds3231Enable32KHzOutput() != DS3231_OPERATION_SUCCESS || ds3231EnableBBSQW(HZ_1) != DS3231_OPERATION_SUCCESS)
+		return 1;
+
+	DDRD &= ~(1 << PD5);
+	PORTD |= (1 << PD5);
+	DDRB &= ~(1 << PB0);
+	PORTB |= (1 << PB0);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		overflowCount = 0;
+		secondTicks = 0;
+		secondCount = 0;
+
+		TCCR1A = 0; // normal mode
+		TCNT1 = 0;
+		TIFR1 = (1 << ICF1) | (1 << TOV1); // clear any stale flags
+		TIMSK1 = (1 << ICIE1) | (1 << TOIE1);
+		// noise canceler on, capture on the falling edge, clocked by T1 rising edge
+		TCCR1B = (1 << ICNC1) | (1 << CS12) | (1 << CS11) | (1 << CS10);
+	}
+
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   stops Timer1, the tick counter holds its value. The ds3231 outputs are left running
+*/
+void ds3231TimestampStop(void)
+{
+	TCCR1B = 0;
+	TIMSK1 = 0;
+}
+
+/*
+   gets the monotonic tick counter without any bus traffic
+	Returns: the number of ticks (1 / 32768 s each) since `ds3231TimestampStart`
+*/
+uint64_t ds3231TimestampNow(void)
+{
+	uint64_t ticks;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ticks = combineTicks(TCNT1);
+	}
+
+	return ticks;
+}
+
+/*
+	Returns: the tick count at the most recent second boundary, 0 if there hasn't been one
+*/
+uint64_t ds3231TimestampLastSecond(void)
+{
+	uint64_t ticks;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		catchUp();
+		ticks = secondTicks;
+	}
+
+	return ticks;
+}
+
+/*
+   gets the position within the current second, for ordering events that happen in the same
+   second of the ds3231 time
+	Returns: the ticks since the most recent second boundary, 0 - 32767
+*/
+uint16_t ds3231TimestampSubsecond(void)
+{
+	uint64_t elapsed;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		catchUp();
+		elapsed = combineTicks(TCNT1) - secondTicks;
+	}
+
+	return elapsed < DS3231_TICKS_PER_SECOND ? (uint16_t) elapsed : DS3231_TICKS_PER_SECOND - 1;
+}
+
+/*
+	Returns: the number of second boundaries seen since `ds3231TimestampStart`
+*/
+uint32_t ds3231TimestampSecondCount(void)
+{
+	uint32_t count;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		catchUp();
+		count = secondCount;
+	}
+
+	return count;
+}
+
+/*
+   extends a 16 bit Timer1 value to the full tick count. A counter value read with interrupts
+   disabled may be from after an overflow that hasn't been counted yet, a low value with the
+   overflow flag set means the overflow happened first. Must be called with interrupts disabled
+	Param: count -> a TCNT1 or ICR1 value
+	Returns: the full tick count
+*/
+static uint64_t combineTicks(uint16_t count)
+{
+	uint32_t overflows = overflowCount;
+	if((TIFR1 & (1 << TOV1)) && count < 0x8000)
+		overflows++;
+
+	return ((uint64_t) overflows << 16) | count;
+}
+
+/*
+   records the tick count of a second boundary from the input capture register
+*/
+static void captureSecond(void)
+{
+	secondTicks = combineTicks(ICR1);
+	secondCount++;
+}
+
+/*
+   handles a second boundary that has been captured but whose interrupt hasn't run yet, so
+   readers with interrupts disabled see it. Must be called with interrupts disabled
+*/
+static void catchUp(void)
+{
+	if(TIFR1 & (1 << ICF1))
+	{
+		captureSecond();
+		TIFR1 = (1 << ICF1);
+	}
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+	captureSecond();
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	overflowCount++;
+}
@@ -0,0 +1,24 @@
+#ifndef GUARD_DS3231_TIMESTAMP_H
+#define GUARD_DS3231_TIMESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the ds3231 32KHz output must be wired to T1 (PD5) and its INT/SQW output to ICP1 (PB0)
+#define DS3231_TICKS_PER_SECOND 32768UL // frequency of the 32KHz output, one tick is ~30.5 us
+
+// converts a number of ticks to microseconds (1000000 / 32768 = 15625 / 512)
+#define DS3231_TICKS_TO_US(ticks) (((uint64_t) (ticks) * 15625) >> 9)
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t ds3231TimestampStart(void);
+void ds3231TimestampStop(void);
+
+uint64_t ds3231TimestampNow(void);
+uint64_t ds3231TimestampLastSecond(void);
+uint16_t ds3231TimestampSubsecond(void);
+uint32_t ds3231TimestampSecondCount(void);
+
+#endif
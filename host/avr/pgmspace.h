@@ -0,0 +1,12 @@
+#ifndef GUARD_HOST_AVR_PGMSPACE_H
+#define GUARD_HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+// flash and RAM share one address space on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+
+#endif
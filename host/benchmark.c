@@ -0,0 +1,412 @@
+/*
+   Measures the bus cost of every public function of DS3231.h, run against the emulated ds3231.
+   Each function is called BENCHMARK_ITERATIONS times and the averages per call are printed as
+   comma separated values:
+
+	api,transactions,starts,bytes,latency_us,host_ns
+
+   transactions, starts (START and repeated START conditions) and bytes (data bytes, not
+   counting the address sent with each START) come from i2cProfile.c. latency_us is the time the
+   call takes on a real 400 kHz bus, including any waits, from the emulator's virtual clock.
+   host_ns is the time the call takes on this PC. All but host_ns are deterministic.
+
+   Given a baseline (a previous output) as its argument, every line is compared against it and
+   the differences are reported on stderr. The exit status is 1 if any function got worse,
+   so `make benchmark` fails on a regression. `make benchmark_baseline` updates the baseline
+*/
+
+#include "DS3231.h"
+#include "i2cProfile.h"
+#include "ds3231Emulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <util/delay.h>
+
+#if !I2C_PROFILE
+#error "the benchmark must be built with I2C_PROFILE defined as 1"
+#endif
+
+#define BENCHMARK_ITERATIONS 100
+#define BENCHMARK_MAX_RESULTS 96
+#define BENCHMARK_NAME_LENGTH 64
+
+// how much worse than the baseline the latency may get before it counts as a regression, the
+// other columns must not get worse at all
+#define BENCHMARK_LATENCY_TOLERANCE 0.01
+
+// a function under test. prepare and finish run before and after every call without being
+// measured and may be NULL
+typedef struct
+{
+	const char *name;
+	void (*prepare)(int);
+	void (*run)(int);
+	void (*finish)(int);
+	int argument;
+} benchmark_t;
+
+// the averages per call of a benchmark
+typedef struct
+{
+	char name[BENCHMARK_NAME_LENGTH];
+	double transactions;
+	double starts;
+	double bytes;
+	double latencyUs;
+	double hostNs;
+} benchmark_result_t;
+
+static datetime_t dateTime = { .second = 58, .minute = 59, .hour = 23, .day = FRIDAY, .date = 31, .month = DECEMBER, .year = 99, .century = 20 };
+static uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+static i2c_transaction_t transaction;
+static char text[DS3231_DATETIME_STRING_LENGTH];
+
+static void initDS3231Run(int argument) { initDS3231(); }
+static void initDS3231OnBusRun(int argument) { initDS3231OnBus(&i2cMasterBus); }
+static void use12HourModeRun(int argument) { ds3231Use12HourMode(argument); }
+static void is12HourModeRun(int argument) { ds3231Is12HourMode(); }
+static void setSecondRun(int argument) { ds3231SetSecond(30); }
+static void getSecondRun(int argument) { ds3231GetSecond(); }
+static void setMinuteRun(int argument) { ds3231SetMinute(30); }
+static void getMinuteRun(int argument) { ds3231GetMinute(); }
+static void setHourRun(int argument) { ds3231SetHour(12, false); }
+static void getHourRun(int argument) { ds3231GetHour(); }
+static void setDayRun(int argument) { ds3231SetDay(WEDNESDAY); }
+static void getDayRun(int argument) { ds3231GetDay(); }
+static void setDateRun(int argument) { ds3231SetDate(15); }
+static void getDateRun(int argument) { ds3231GetDate(); }
+static void setMonthRun(int argument) { ds3231SetMonth(JUNE); }
+static void getMonthRun(int argument) { ds3231GetMonth(); }
+static void setYearRun(int argument) { ds3231SetYear(16); }
+static void getYearRun(int argument) { ds3231GetYear(); }
+static void setCenturyRun(int argument) { ds3231SetCentury(21); }
+static void getCenturyRun(int argument) { ds3231GetCentury(); }
+static void setFullDateRun(int argument) { ds3231SetFullDate(WEDNESDAY, 28, DECEMBER, 16, 21); }
+static void setTimeRun(int argument) { ds3231SetTime(14, 59, 58, false); }
+static void setDateTimeRun(int argument) { ds3231SetDateTime(&dateTime); }
+static void getDateTimeRun(int argument) { ds3231GetDateTime(&dateTime); }
+static void requestDateTimeRun(int argument) { ds3231RequestDateTime(&transaction, registers, NULL); }
+static void decodeDateTimeRun(int argument) { ds3231DecodeDateTime(registers, &dateTime); }
+static void getDateTimeStringRun(int argument) { ds3231GetDateTimeString(text); }
+static void formatDateTimeRun(int argument) { ds3231FormatDateTime(registers, text); }
+static void dateTimeToSecondsRun(int argument) { ds3231DateTimeToSeconds(&dateTime); }
+static void secondsToDateTimeRun(int argument) { ds3231SecondsToDateTime(536457599UL, &dateTime); }
+static void setAlarmRun(int argument);
+static void clearAlarmFlagRun(int argument) { ds3231ClearAlarmFlag(ALARM_1); }
+static void clearAlarmFlagsRun(int argument) { ds3231ClearAlarmFlags(); }
+static void removeAlarmRun(int argument) { ds3231RemoveAlarm(ALARM_1); }
+static void forceTemperatureUpdateRun(int argument) { ds3231ForceTemperatureUpdate(); }
+static void startTemperatureConversionRun(int argument) { ds3231StartTemperatureConversion(NULL); }
+static void isTemperatureReadyRun(int argument) { ds3231IsTemperatureReady(); }
+static void temperatureServiceRun(int argument) { ds3231TemperatureService(ds3231EmulatorGetTime() / 1000000); }
+static void getTemperatureRun(int argument) { ds3231GetTemperature(); }
+static void getTemperatureHundredthsRun(int argument) { ds3231GetTemperatureHundredths(); }
+static void temperatureToHundredthsRun(int argument) { ds3231TemperatureToHundredths(0x1940); }
+static void disableOscillatorOnBatteryRun(int argument) { ds3231DisableOscillatorOnBattery(); }
+static void enableOscillatorOnBatteryRun(int argument) { ds3231EnableOscillatorOnBattery(); }
+static void hasOscillatorStoppedRun(int argument) { ds3231HasOscillatorStopped(); }
+static void enable32KHzOutputRun(int argument) { ds3231Enable32KHzOutput(); }
+static void disable32KhzOutputRun(int argument) { ds3231Disable32KhzOutput(); }
+static void setAgingOffsetRun(int argument) { ds3231SetAgingOffset(argument); }
+static void getAgingOffsetRun(int argument) { ds3231GetAgingOffset(); }
+static void enableBBSQWRun(int argument) { ds3231EnableBBSQW(argument); }
+static void useWriteBackRun(int argument) { ds3231UseWriteBack(argument); }
+static void flushRun(int argument) { ds3231Flush(); }
+
+static void readRegisters(int argument);
+static void startConversion(int argument);
+static void startTimedConversion(int argument);
+static void finishConversion(int argument);
+static void dirtyRegisters(int argument);
+static void writeThrough(int argument);
+
+static const benchmark_t benchmarks[] =
+{
+	{ "initDS3231", NULL, initDS3231Run, NULL, 0 },
+	{ "initDS3231OnBus", NULL, initDS3231OnBusRun, NULL, 0 },
+	{ "ds3231Use12HourMode", NULL, use12HourModeRun, NULL, false },
+	{ "ds3231Is12HourMode", NULL, is12HourModeRun, NULL, 0 },
+	{ "ds3231SetSecond", NULL, setSecondRun, NULL, 0 },
+	{ "ds3231GetSecond", NULL, getSecondRun, NULL, 0 },
+	{ "ds3231SetMinute", NULL, setMinuteRun, NULL, 0 },
+	{ "ds3231GetMinute", NULL, getMinuteRun, NULL, 0 },
+	{ "ds3231SetHour", NULL, setHourRun, NULL, 0 },
+	{ "ds3231GetHour", NULL, getHourRun, NULL, 0 },
+	{ "ds3231SetDay", NULL, setDayRun, NULL, 0 },
+	{ "ds3231GetDay", NULL, getDayRun, NULL, 0 },
+	{ "ds3231SetDate", NULL, setDateRun, NULL, 0 },
+	{ "ds3231GetDate", NULL, getDateRun, NULL, 0 },
+	{ "ds3231SetMonth", NULL, setMonthRun, NULL, 0 },
+	{ "ds3231GetMonth", NULL, getMonthRun, NULL, 0 },
+	{ "ds3231SetYear", NULL, setYearRun, NULL, 0 },
+	{ "ds3231GetYear", NULL, getYearRun, NULL, 0 },
+	{ "ds3231SetCentury", NULL, setCenturyRun, NULL, 0 },
+	{ "ds3231GetCentury", NULL, getCenturyRun, NULL, 0 },
+	{ "ds3231SetFullDate", NULL, setFullDateRun, NULL, 0 },
+	{ "ds3231SetTime", NULL, setTimeRun, NULL, 0 },
+	{ "ds3231SetDateTime", NULL, setDateTimeRun, NULL, 0 },
+	{ "ds3231GetDateTime", NULL, getDateTimeRun, NULL, 0 },
+	{ "ds3231RequestDateTime", NULL, requestDateTimeRun, NULL, 0 },
+	{ "ds3231DecodeDateTime", readRegisters, decodeDateTimeRun, NULL, 0 },
+	{ "ds3231GetDateTimeString", NULL, getDateTimeStringRun, NULL, 0 },
+	{ "ds3231FormatDateTime", readRegisters, formatDateTimeRun, NULL, 0 },
+	{ "ds3231DateTimeToSeconds", NULL, dateTimeToSecondsRun, NULL, 0 },
+	{ "ds3231SecondsToDateTime", NULL, secondsToDateTimeRun, NULL, 0 },
+	{ "ds3231SetAlarm(A1_EVERY_SEC)", NULL, setAlarmRun, NULL, A1_EVERY_SEC },
+	{ "ds3231SetAlarm(A1_SEC_MATCH)", NULL, setAlarmRun, NULL, A1_SEC_MATCH },
+	{ "ds3231SetAlarm(A1_MIN_SEC_MATCH)", NULL, setAlarmRun, NULL, A1_MIN_SEC_MATCH },
+	{ "ds3231SetAlarm(A1_HOUR_MIN_SEC_MATCH)", NULL, setAlarmRun, NULL, A1_HOUR_MIN_SEC_MATCH },
+	{ "ds3231SetAlarm(A1_DAY_DATE_HOUR_MIN_SEC_MATCH)", NULL, setAlarmRun, NULL, A1_DAY_DATE_HOUR_MIN_SEC_MATCH },
+	{ "ds3231SetAlarm(A2_EVERY_MIN)", NULL, setAlarmRun, NULL, A2_EVERY_MIN },
+	{ "ds3231SetAlarm(A2_MIN_MATCH)", NULL, setAlarmRun, NULL, A2_MIN_MATCH },
+	{ "ds3231SetAlarm(A2_HOUR_MIN_MATCH)", NULL, setAlarmRun, NULL, A2_HOUR_MIN_MATCH },
+	{ "ds3231SetAlarm(A2_DAY_DATE_HOUR_MIN_MATCH)", NULL, setAlarmRun, NULL, A2_DAY_DATE_HOUR_MIN_MATCH },
+	{ "ds3231ClearAlarmFlag", NULL, clearAlarmFlagRun, NULL, 0 },
+	{ "ds3231ClearAlarmFlags", NULL, clearAlarmFlagsRun, NULL, 0 },
+	{ "ds3231RemoveAlarm", NULL, removeAlarmRun, NULL, 0 },
+	{ "ds3231ForceTemperatureUpdate", NULL, forceTemperatureUpdateRun, NULL, 0 },
+	{ "ds3231StartTemperatureConversion", NULL, startTemperatureConversionRun, finishConversion, 0 },
+	{ "ds3231IsTemperatureReady", startConversion, isTemperatureReadyRun, finishConversion, 0 },
+	{ "ds3231TemperatureService", startTimedConversion, temperatureServiceRun, finishConversion, 0 },
+	{ "ds3231GetTemperature", NULL, getTemperatureRun, NULL, 0 },
+	{ "ds3231GetTemperatureHundredths", NULL, getTemperatureHundredthsRun, NULL, 0 },
+	{ "ds3231TemperatureToHundredths", NULL, temperatureToHundredthsRun, NULL, 0 },
+	{ "ds3231DisableOscillatorOnBattery", NULL, disableOscillatorOnBatteryRun, NULL, 0 },
+	{ "ds3231EnableOscillatorOnBattery", NULL, enableOscillatorOnBatteryRun, NULL, 0 },
+	{ "ds3231HasOscillatorStopped", NULL, hasOscillatorStoppedRun, NULL, 0 },
+	{ "ds3231Enable32KHzOutput", NULL, enable32KHzOutputRun, NULL, 0 },
+	{ "ds3231Disable32KhzOutput", NULL, disable32KhzOutputRun, NULL, 0 },
+	{ "ds3231SetAgingOffset", NULL, setAgingOffsetRun, NULL, -3 },
+	{ "ds3231GetAgingOffset", NULL, getAgingOffsetRun, NULL, 0 },
+	{ "ds3231EnableBBSQW", NULL, enableBBSQWRun, NULL, KHZ_1_024 },
+	{ "ds3231UseWriteBack", dirtyRegisters, useWriteBackRun, NULL, false },
+	{ "ds3231Flush", dirtyRegisters, flushRun, writeThrough, 0 }
+};
+
+static void runBenchmark(const benchmark_t *, benchmark_result_t *);
+static uint64_t hostTimeNs(void);
+static int readBaseline(const char *, benchmark_result_t *);
+static bool compareResult(const benchmark_result_t *, const benchmark_result_t *, int);
+static bool compareColumn(const char *, const char *, double, double, double);
+
+int main(int argc, char *argv[])
+{
+	static benchmark_result_t baseline[BENCHMARK_MAX_RESULTS];
+	int baselineCount = -1;
+	bool isWorse = false;
+
+	if(argc > 1 && (baselineCount = readBaseline(argv[1], baseline)) < 0)
+	{
+		fprintf(stderr, "cannot read the baseline %s\n", argv[1]);
+		return 2;
+	}
+
+	initI2CProfile();
+	printf("api,transactions,starts,bytes,latency_us,host_ns\n");
+	for(size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+	{
+		benchmark_result_t result;
+		runBenchmark(&benchmarks[i], &result);
+		printf("%s,%.2f,%.2f,%.2f,%.2f,%.2f\n", result.name, result.transactions, result.starts, result.bytes, result.latencyUs, result.hostNs);
+
+		if(baselineCount >= 0 && !compareResult(&result, baseline, baselineCount))
+			isWorse = true;
+	}
+
+	if(baselineCount >= 0)
+		fprintf(stderr, isWorse ? "worse than the baseline\n" : "no worse than the baseline\n");
+
+	return isWorse ? 1 : 0;
+}
+
+/*
+   runs one benchmark on a freshly powered ds3231, in 24 hour mode
+	Param: benchmark -> the function to measure
+		   result -> filled with the averages per call
+*/
+static void runBenchmark(const benchmark_t *benchmark, benchmark_result_t *result)
+{
+	uint64_t latencyNs = 0;
+	uint64_t hostNs = 0;
+
+	ds3231EmulatorReset();
+	ds3231Use12HourMode(false);
+	ds3231SetCentury(21);
+	initDS3231();
+	i2cProfileReset();
+
+	i2c_profile_entry_t before;
+	i2c_profile_entry_t after;
+	i2c_profile_entry_t total = { .name = NULL };
+	for(uint16_t i = 0; i < BENCHMARK_ITERATIONS; i++)
+	{
+		if(benchmark->prepare != NULL)
+			benchmark->prepare(benchmark->argument);
+
+		i2cProfileGetTotal(&before);
+		uint64_t emulatorStart = ds3231EmulatorGetTime();
+		uint64_t hostStart = hostTimeNs();
+		benchmark->run(benchmark->argument);
+		hostNs += hostTimeNs() - hostStart;
+		latencyNs += ds3231EmulatorGetTime() - emulatorStart;
+		i2cProfileGetTotal(&after);
+
+		total.transactions += after.transactions - before.transactions;
+		total.starts += after.starts - before.starts;
+		total.bytes += after.bytes - before.bytes;
+
+		if(benchmark->finish != NULL)
+			benchmark->finish(benchmark->argument);
+	}
+
+	snprintf(result->name, sizeof(result->name), "%s", benchmark->name);
+	result->transactions = (double) total.transactions / BENCHMARK_ITERATIONS;
+	result->starts = (double) total.starts / BENCHMARK_ITERATIONS;
+	result->bytes = (double) total.bytes / BENCHMARK_ITERATIONS;
+	result->latencyUs = latencyNs / 1000.0 / BENCHMARK_ITERATIONS;
+	result->hostNs = (double) hostNs / BENCHMARK_ITERATIONS;
+}
+
+/*
+   sets an alarm that uses every field its trigger matches
+	Param: trigger -> an alarm_trigger_t, selects ALARM_1 or ALARM_2
+*/
+static void setAlarmRun(int trigger)
+{
+	alarm_t alarm =
+	{
+		.alarmNumber = trigger < A2_EVERY_MIN ? ALARM_1 : ALARM_2,
+		.second = trigger < A2_EVERY_MIN ? 30 : 0,
+		.minute = 15,
+		.hour = 7,
+		.useDay = false,
+		.dayDate = 12,
+		.trigger = trigger
+	};
+
+	ds3231SetAlarm(&alarm);
+}
+
+// fills registers with a snapshot for the functions that decode one
+static void readRegisters(int argument)
+{
+	getRegisterValues(DS3231_REGISTER_SECONDS, registers, DS3231_DATETIME_REGISTER_COUNT);
+}
+
+// starts a forced conversion so there is something to poll
+static void startConversion(int argument)
+{
+	ds3231StartTemperatureConversion(NULL);
+}
+
+// starts a forced conversion and lets ds3231TemperatureService time it, so the next call polls
+static void startTimedConversion(int argument)
+{
+	ds3231StartTemperatureConversion(NULL);
+	ds3231TemperatureService(ds3231EmulatorGetTime() / 1000000);
+	_delay_ms(DS3231_TEMPERATURE_CONVERSION_MS);
+}
+
+static void finishConversion(int argument)
+{
+	while(!ds3231IsTemperatureReady())
+		_delay_ms(DS3231_TEMPERATURE_POLL_INTERVAL_MS);
+}
+
+// leaves the time, an alarm and the aging offset waiting to be flushed in write back mode
+static void dirtyRegisters(int argument)
+{
+	ds3231UseWriteBack(true);
+	ds3231SetTime(8, 30, 0, false);
+	ds3231SetMinute(31);
+	ds3231SetAgingOffset(2);
+}
+
+static void writeThrough(int argument)
+{
+	ds3231UseWriteBack(false);
+}
+
+static uint64_t hostTimeNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+   reads a previous output of the benchmark
+	Param: path -> the file to read
+		   baseline -> filled with the results read, BENCHMARK_MAX_RESULTS at most
+	Returns: the number of results read, -1 if the file could not be opened
+*/
+static int readBaseline(const char *path, benchmark_result_t *baseline)
+{
+	FILE *file = fopen(path, "r");
+	if(file == NULL)
+		return -1;
+
+	char line[256];
+	int count = 0;
+	while(count < BENCHMARK_MAX_RESULTS && fgets(line, sizeof(line), file) != NULL)
+	{
+		benchmark_result_t *result = &baseline[count];
+		char *comma = strchr(line, ',');
+		if(comma == NULL || comma - line >= BENCHMARK_NAME_LENGTH)
+			continue;
+
+		*comma = '\0';
+		if(sscanf(comma + 1, "%lf,%lf,%lf,%lf,%lf", &result->transactions, &result->starts, &result->bytes, &result->latencyUs, &result->hostNs) != 5)
+			continue; // the header
+		strcpy(result->name, line);
+		count++;
+	}
+	fclose(file);
+
+	return count;
+}
+
+/*
+   compares a result with the baseline result of the same name, reporting any difference
+	Returns: false if the result is worse than the baseline
+*/
+static bool compareResult(const benchmark_result_t *result, const benchmark_result_t *baseline, int baselineCount)
+{
+	for(int i = 0; i < baselineCount; i++)
+	{
+		if(strcmp(baseline[i].name, result->name) != 0)
+			continue;
+
+		bool isNoWorse = compareColumn(result->name, "transactions", result->transactions, baseline[i].transactions, 0);
+		isNoWorse &= compareColumn(result->name, "starts", result->starts, baseline[i].starts, 0);
+		isNoWorse &= compareColumn(result->name, "bytes", result->bytes, baseline[i].bytes, 0);
+		isNoWorse &= compareColumn(result->name, "latency_us", result->latencyUs, baseline[i].latencyUs, BENCHMARK_LATENCY_TOLERANCE);
+		return isNoWorse;
+	}
+
+	fprintf(stderr, "%s: not in the baseline\n", result->name);
+	return true;
+}
+
+/*
+	Param: tolerance -> the fraction value may be above baseline without being worse
+	Returns: false if value is worse than baseline
+*/
+static bool compareColumn(const char *name, const char *column, double value, double baseline, double tolerance)
+{
+	const double rounding = 0.005; // the baseline has two decimal places
+
+	if(value > baseline * (1 + tolerance) + rounding)
+	{
+		fprintf(stderr, "%s: %s worse, %.2f was %.2f\n", name, column, value, baseline);
+		return false;
+	}
+	if(value < baseline - rounding)
+		fprintf(stderr, "%s: %s better, %.2f was %.2f\n", name, column, value, baseline);
+
+	return true;
+}
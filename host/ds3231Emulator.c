@@ -0,0 +1,505 @@
+#include "ds3231Emulator.h"
+#include "DS3231.h"
+
+#include <string.h>
+
+#define NS_PER_SECOND 1000000000ULL
+
+// the registers as the ds3231 keeps them
+static uint8_t registers[DS3231_REGISTER_COUNT];
+// copy of SECONDS to YEAR taken on every START, reads of those registers come from here so a
+// burst read can't tear when the time ticks over during it
+static uint8_t timeBuffer[DS3231_DATETIME_REGISTER_COUNT];
+
+// bus state
+static bool selected = false; // addressed since the last START
+static bool reading = false;
+static bool pointerSet = false; // the first byte of a write has set the register pointer
+static uint8_t pointer = 0;
+
+// virtual clock
+static uint64_t now = 0; // nanoseconds since reset
+static uint64_t secondStart = 0; // when the current second started
+static bool onBattery = false;
+static bool responding = true; // false to NAK every address, as a ds3231 that is missing
+
+// temperature conversions
+static int16_t temperatureQuarters = 25 * 4; // the temperature the next conversion measures
+static uint64_t conversionEnd = 0; // when the running conversion finishes, 0 if none is
+static bool forcedConversionPending = false; // CONV was set while a conversion was running
+static uint8_t secondsToConversion = DS3231_EMULATOR_CONVERSION_INTERVAL;
+
+static void latchTime(void);
+static void writeRegister(uint8_t, uint8_t);
+static void tick(void);
+static void checkAlarms(void);
+static bool alarmTimeMatches(uint8_t, uint8_t);
+static bool alarmHoursMatch(uint8_t);
+static bool alarmDayDateMatches(uint8_t);
+static uint8_t hoursTo24(uint8_t);
+static void startConversion(void);
+static void finishConversion(void);
+static bool isOscillatorRunning(void);
+static uint8_t daysInMonth(uint8_t, uint8_t);
+static uint8_t toBcd(uint8_t);
+static uint8_t fromBcd(uint8_t);
+
+/*
+   puts the emulated ds3231 in its power on state: 2000-01-01 00:00:00 (a saturday, day 7 with
+   SUNDAY as day 1), 24 hour mode, CONTROL 0x1c, OSF and EN32kHz set, and the virtual clock at 0
+*/
+void ds3231EmulatorReset(void)
+{
+	memset(registers, 0, sizeof(registers));
+	registers[DS3231_REGISTER_DAY] = 7;
+	registers[DS3231_REGISTER_DATE] = 1;
+	registers[DS3231_REGISTER_MONTH_CENTURY] = 1;
+	registers[DS3231_REGISTER_CONTROL] = DS3231_CONTROL_RS2_BIT | DS3231_CONTROL_RS1_BIT | DS3231_CONTROL_INTCN_BIT;
+	registers[DS3231_REGISTER_STATUS] = DS3231_STATUS_OSF_BIT | DS3231_STATUS_EN32KHZ_BIT;
+	registers[DS3231_REGISTER_TEMPERATURE_MSB] = temperatureQuarters >> 2;
+	registers[DS3231_REGISTER_TEMPERATURE_LSB] = (temperatureQuarters & 3) << 6;
+
+	selected = reading = pointerSet = false;
+	pointer = 0;
+	now = secondStart = 0;
+	onBattery = false;
+	responding = true;
+	conversionEnd = 0;
+	forcedConversionPending = false;
+	secondsToConversion = DS3231_EMULATOR_CONVERSION_INTERVAL;
+	latchTime();
+}
+
+/*
+   a START (or repeated START) followed by an address byte
+	Param: address -> the 8 bit address byte, 7 bit address and direction bit
+	Returns: true if the ds3231 acknowledged the address
+*/
+bool ds3231EmulatorStart(uint8_t address)
+{
+	latchTime();
+
+	selected = responding && (address >> 1) == DS3231_EMULATOR_ADDRESS;
+	reading = address & 1;
+	pointerSet = false;
+
+	return selected;
+}
+
+/*
+   a byte written by the master. The first byte after a write address sets the register
+   pointer, the rest are written to registers
+	Returns: true if the ds3231 acknowledged the byte
+*/
+bool ds3231EmulatorWrite(uint8_t data)
+{
+	if(!selected || reading)
+		return false;
+
+	if(!pointerSet)
+	{
+		if(data >= DS3231_REGISTER_COUNT)
+			return false;
+		pointer = data;
+		pointerSet = true;
+		return true;
+	}
+
+	writeRegister(pointer, data);
+	pointer = (pointer + 1) % DS3231_REGISTER_COUNT;
+	return true;
+}
+
+/*
+   a byte read by the master, from the register pointer which then moves on
+	Returns: the register value, 0xff (the bus idles high) if the ds3231 isn't being read
+*/
+uint8_t ds3231EmulatorRead(void)
+{
+	if(!selected || !reading)
+		return 0xff;
+
+	uint8_t value = pointer < DS3231_DATETIME_REGISTER_COUNT ? timeBuffer[pointer] : registers[pointer];
+
+	pointer = (pointer + 1) % DS3231_REGISTER_COUNT;
+	if(pointer == 0) // the time is latched again when the pointer wraps
+		latchTime();
+
+	return value;
+}
+
+/*
+   a STOP condition
+*/
+void ds3231EmulatorStop(void)
+{
+	selected = false;
+}
+
+/*
+   lets virtual time pass, running the time keeping and temperature conversions
+	Param: nanoseconds -> how long to advance the virtual clock by
+*/
+void ds3231EmulatorAdvance(uint64_t nanoseconds)
+{
+	uint64_t end = now + nanoseconds;
+
+	// handle each event in order, a tick may start a conversion that ends before the next tick
+	while(1)
+	{
+		uint64_t nextTick = isOscillatorRunning() ? secondStart + NS_PER_SECOND : UINT64_MAX;
+		uint64_t nextConversion = conversionEnd != 0 ? conversionEnd : UINT64_MAX;
+		uint64_t next = nextTick < nextConversion ? nextTick : nextConversion;
+		if(next > end)
+			break;
+
+		now = next;
+		if(next == nextConversion)
+		{
+			finishConversion();
+		}
+		else
+		{
+			secondStart = now;
+			tick();
+		}
+	}
+
+	now = end;
+	if(!isOscillatorRunning())
+		secondStart = now;
+}
+
+/*
+	Returns: the virtual time in nanoseconds since ds3231EmulatorReset
+*/
+uint64_t ds3231EmulatorGetTime(void)
+{
+	return now;
+}
+
+/*
+   reads a register without going through the bus
+	Param: reg -> the register address, e.g. DS3231_REGISTER_STATUS
+	Returns: the value of the register
+*/
+uint8_t ds3231EmulatorGetRegister(uint8_t reg)
+{
+	return reg < DS3231_REGISTER_COUNT ? registers[reg] : 0xff;
+}
+
+/*
+   sets a register without going through the bus, bypassing the rules of bus writes (so
+   BSY, A1F, A2F and OSF can be set)
+	Param: reg -> the register address
+		   value -> the value to store
+*/
+void ds3231EmulatorSetRegister(uint8_t reg, uint8_t value)
+{
+	if(reg < DS3231_REGISTER_COUNT)
+		registers[reg] = value;
+}
+
+/*
+   sets the temperature the next conversion will measure
+	Param: hundredths -> the temperature in hundredths of a degree celcius, rounded down to 0.25
+*/
+void ds3231EmulatorSetTemperature(int16_t hundredths)
+{
+	int16_t quarters = hundredths / 25;
+	if(hundredths < 0 && hundredths % 25)
+		quarters--;
+	temperatureQuarters = quarters;
+}
+
+/*
+   switches the emulated supply between VCC and the battery. On battery the oscillator stops
+   if EOSC is set, which also sets OSF
+	Param: battery -> true to run from the battery
+*/
+void ds3231EmulatorSetBatteryPower(bool battery)
+{
+	onBattery = battery;
+	if(!isOscillatorRunning())
+		registers[DS3231_REGISTER_STATUS] |= DS3231_STATUS_OSF_BIT;
+}
+
+/*
+   makes the emulated ds3231 NAK every address until it is responding again, to test how bus
+   errors are handled. The registers and time keeping are unaffected
+	Param: isResponding -> false to NAK every address
+*/
+void ds3231EmulatorSetResponding(bool isResponding)
+{
+	responding = isResponding;
+}
+
+/*
+	Returns: true if the INT/SQW pin is pulled low by an enabled alarm
+*/
+bool ds3231EmulatorIsInterruptActive(void)
+{
+	uint8_t control = registers[DS3231_REGISTER_CONTROL];
+	uint8_t status = registers[DS3231_REGISTER_STATUS];
+
+	if(!(control & DS3231_CONTROL_INTCN_BIT))
+		return false;
+
+	return ((control & DS3231_CONTROL_A1IE_BIT) && (status & DS3231_STATUS_A1F_BIT)) ||
+		((control & DS3231_CONTROL_A2IE_BIT) && (status & DS3231_STATUS_A2F_BIT));
+}
+
+/*
+   copies the time keeping registers to the buffer reads are served from
+*/
+static void latchTime(void)
+{
+	memcpy(timeBuffer, registers, sizeof(timeBuffer));
+}
+
+/*
+   a register write from the bus, following the rules of the ds3231
+*/
+static void writeRegister(uint8_t reg, uint8_t value)
+{
+	switch(reg)
+	{
+		case DS3231_REGISTER_SECONDS: // writing the seconds restarts the current second
+			registers[reg] = value & 0x7f;
+			secondStart = now;
+			break;
+
+		case DS3231_REGISTER_CONTROL:
+			if((value & DS3231_CONTROL_CONV_BIT) && !(registers[reg] & DS3231_CONTROL_CONV_BIT))
+			{
+				registers[reg] = value;
+				if(conversionEnd == 0)
+					startConversion();
+				else // the running conversion finishes first
+					forcedConversionPending = true;
+			}
+			else // CONV can't be cleared by a write, only by the conversion finishing
+			{
+				registers[reg] = value | (registers[reg] & DS3231_CONTROL_CONV_BIT);
+			}
+			break;
+
+		case DS3231_REGISTER_STATUS:
+		{
+			// OSF, A2F and A1F can only be cleared, BSY is read only
+			uint8_t clearable = DS3231_STATUS_OSF_BIT | DS3231_STATUS_A2F_BIT | DS3231_STATUS_A1F_BIT;
+			uint8_t kept = registers[reg] & (value | ~clearable) & (clearable | DS3231_STATUS_BSY_BIT);
+			registers[reg] = kept | (value & DS3231_STATUS_EN32KHZ_BIT);
+			break;
+		}
+
+		case DS3231_REGISTER_TEMPERATURE_MSB: // read only
+		case DS3231_REGISTER_TEMPERATURE_LSB:
+			break;
+
+		default:
+			registers[reg] = value;
+			break;
+	}
+}
+
+/*
+   advances the time keeping registers by one second, then checks the alarms and whether an
+   automatic temperature conversion is due
+*/
+static void tick(void)
+{
+	uint8_t second = fromBcd(registers[DS3231_REGISTER_SECONDS]) + 1;
+	uint8_t minute = fromBcd(registers[DS3231_REGISTER_MINUTES]);
+	uint8_t hoursRegister = registers[DS3231_REGISTER_HOURS];
+	uint8_t hour = hoursTo24(hoursRegister);
+	uint8_t day = fromBcd(registers[DS3231_REGISTER_DAY]);
+	uint8_t date = fromBcd(registers[DS3231_REGISTER_DATE]);
+	uint8_t monthRegister = registers[DS3231_REGISTER_MONTH_CENTURY];
+	uint8_t month = fromBcd(monthRegister & 0x1f);
+	uint8_t year = fromBcd(registers[DS3231_REGISTER_YEAR]);
+	uint8_t centuryBit = monthRegister & DS3231_CENTURY_BIT;
+
+	if(second == 60)
+	{
+		second = 0;
+		if(++minute == 60)
+		{
+			minute = 0;
+			if(++hour == 24)
+			{
+				hour = 0;
+				day = day % 7 + 1;
+				if(++date > daysInMonth(month, year))
+				{
+					date = 1;
+					if(++month > 12)
+					{
+						month = 1;
+						if(++year == 100)
+						{
+							year = 0;
+							centuryBit = DS3231_CENTURY_BIT;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	registers[DS3231_REGISTER_SECONDS] = toBcd(second);
+	registers[DS3231_REGISTER_MINUTES] = toBcd(minute);
+	if(hoursRegister & DS3231_HOUR_MODE_12_BIT)
+	{
+		uint8_t hour12 = hour % 12 == 0 ? 12 : hour % 12;
+		registers[DS3231_REGISTER_HOURS] = DS3231_HOUR_MODE_12_BIT | (hour >= 12 ? DS3231_PM_BIT : 0) | toBcd(hour12);
+	}
+	else
+	{
+		registers[DS3231_REGISTER_HOURS] = toBcd(hour);
+	}
+	registers[DS3231_REGISTER_DAY] = toBcd(day);
+	registers[DS3231_REGISTER_DATE] = toBcd(date);
+	registers[DS3231_REGISTER_MONTH_CENTURY] = centuryBit | toBcd(month);
+	registers[DS3231_REGISTER_YEAR] = toBcd(year);
+
+	checkAlarms();
+
+	if(--secondsToConversion == 0)
+	{
+		secondsToConversion = DS3231_EMULATOR_CONVERSION_INTERVAL;
+		if(conversionEnd == 0)
+			startConversion();
+	}
+}
+
+/*
+   sets A1F and/or A2F if the new time matches the alarms. Alarm 1 is checked every second,
+   alarm 2 (which has no seconds register) at the start of every minute
+*/
+static void checkAlarms(void)
+{
+	const uint8_t *alarm1 = &registers[DS3231_REGISTER_ALARM1_SECONDS];
+	const uint8_t *alarm2 = &registers[DS3231_REGISTER_ALARM2_MINUTES];
+
+	if(alarmTimeMatches(alarm1[0], registers[DS3231_REGISTER_SECONDS]) &&
+	   alarmTimeMatches(alarm1[1], registers[DS3231_REGISTER_MINUTES]) &&
+	   alarmHoursMatch(alarm1[2]) && alarmDayDateMatches(alarm1[3]))
+		registers[DS3231_REGISTER_STATUS] |= DS3231_STATUS_A1F_BIT;
+
+	if(registers[DS3231_REGISTER_SECONDS] == 0 &&
+	   alarmTimeMatches(alarm2[0], registers[DS3231_REGISTER_MINUTES]) &&
+	   alarmHoursMatch(alarm2[1]) && alarmDayDateMatches(alarm2[2]))
+		registers[DS3231_REGISTER_STATUS] |= DS3231_STATUS_A2F_BIT;
+}
+
+/*
+   the alarm registers match anything when their mask bit (bit 7) is set
+	Param: alarmRegister -> an alarm seconds or minutes register
+		   timeRegister -> the SECONDS or MINUTES register
+	Returns: true if the alarm register matches the time
+*/
+static bool alarmTimeMatches(uint8_t alarmRegister, uint8_t timeRegister)
+{
+	if(alarmRegister & DS3231_ALARM1_A1M1_BIT)
+		return true;
+
+	return (alarmRegister & 0x7f) == (timeRegister & 0x7f);
+}
+
+/*
+   either register may be in 12 or 24 hour mode, so the hours are compared in 24 hour form
+	Returns: true if an alarm hours register matches the HOURS register
+*/
+static bool alarmHoursMatch(uint8_t alarmRegister)
+{
+	if(alarmRegister & DS3231_ALARM1_A1M3_BIT)
+		return true;
+
+	return hoursTo24(alarmRegister) == hoursTo24(registers[DS3231_REGISTER_HOURS]);
+}
+
+/*
+	Returns: true if an alarm day/date register matches the DAY or DATE register, picked by
+			 its DY/DT bit
+*/
+static bool alarmDayDateMatches(uint8_t alarmRegister)
+{
+	if(alarmRegister & DS3231_ALARM1_A1M4_BIT)
+		return true;
+
+	if(alarmRegister & DS3231_ALARM_DAY_BIT)
+		return (alarmRegister & 0x0f) == registers[DS3231_REGISTER_DAY];
+
+	return (alarmRegister & 0x3f) == registers[DS3231_REGISTER_DATE];
+}
+
+/*
+	Param: hoursRegister -> an HOURS (or alarm hours) register value in either mode
+	Returns: the hour from 0 to 23
+*/
+static uint8_t hoursTo24(uint8_t hoursRegister)
+{
+	if(!(hoursRegister & DS3231_HOUR_MODE_12_BIT))
+		return fromBcd(hoursRegister & 0x3f);
+
+	uint8_t hour = fromBcd(hoursRegister & 0x1f) % 12;
+	return hoursRegister & DS3231_PM_BIT ? hour + 12 : hour;
+}
+
+static void startConversion(void)
+{
+	registers[DS3231_REGISTER_STATUS] |= DS3231_STATUS_BSY_BIT;
+	conversionEnd = now + DS3231_EMULATOR_CONVERSION_NS;
+}
+
+/*
+   stores the measured temperature and clears BSY and CONV, or starts a forced conversion
+   that was requested during an automatic one
+*/
+static void finishConversion(void)
+{
+	registers[DS3231_REGISTER_TEMPERATURE_MSB] = (uint8_t) (temperatureQuarters >> 2);
+	registers[DS3231_REGISTER_TEMPERATURE_LSB] = (temperatureQuarters & 3) << 6;
+	conversionEnd = 0;
+
+	if(forcedConversionPending)
+	{
+		forcedConversionPending = false;
+		startConversion();
+		return;
+	}
+
+	registers[DS3231_REGISTER_STATUS] &= ~DS3231_STATUS_BSY_BIT;
+	registers[DS3231_REGISTER_CONTROL] &= ~DS3231_CONTROL_CONV_BIT;
+}
+
+/*
+	Returns: false if the oscillator is stopped, which it is on battery power with EOSC set
+*/
+static bool isOscillatorRunning(void)
+{
+	return !(onBattery && (registers[DS3231_REGISTER_CONTROL] & DS3231_CONTROL_EOSC_BIT));
+}
+
+/*
+	Returns: the number of days in a month, every year divisible by 4 is a leap year as on the ds3231
+*/
+static uint8_t daysInMonth(uint8_t month, uint8_t year)
+{
+	static const uint8_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	if(month == 2 && year % 4 == 0)
+		return 29;
+	return month >= 1 && month <= 12 ? days[month - 1] : 31;
+}
+
+static uint8_t toBcd(uint8_t value)
+{
+	return (value / 10) << 4 | value % 10;
+}
+
+static uint8_t fromBcd(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0f);
+}
@@ -0,0 +1,45 @@
+#ifndef GUARD_DS3231_EMULATOR_H
+#define GUARD_DS3231_EMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   A register level model of the ds3231 for building and testing DS3231.c on a PC, driven by
+   host/i2cHost.c. It models the SECONDS to TEMPERATURE_LSB register file, the auto incrementing
+   register pointer (which wraps from TEMPERATURE_LSB to SECONDS), the time keeping registers
+   being latched on every START, time keeping in 12 and 24 hour mode with the century bit,
+   alarm matching setting A1F/A2F, forced (CONV) and automatic (every 64 seconds) temperature
+   conversions with BSY, and OSF. Time only passes when the virtual clock is advanced, which
+   the host i2c functions and _delay_ms/_delay_us do
+*/
+
+#define DS3231_EMULATOR_ADDRESS 0x68 // 7 bit i2c address, 0b11010000 >> 1
+
+#define DS3231_EMULATOR_CONVERSION_NS 125000000UL // length of a temperature conversion
+#define DS3231_EMULATOR_CONVERSION_INTERVAL 64 // seconds between automatic temperature conversions
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+void ds3231EmulatorReset(void);
+
+// i2c bus side
+bool ds3231EmulatorStart(uint8_t);
+bool ds3231EmulatorWrite(uint8_t);
+uint8_t ds3231EmulatorRead(void);
+void ds3231EmulatorStop(void);
+
+// virtual clock
+void ds3231EmulatorAdvance(uint64_t);
+uint64_t ds3231EmulatorGetTime(void);
+
+// test side
+uint8_t ds3231EmulatorGetRegister(uint8_t);
+void ds3231EmulatorSetRegister(uint8_t, uint8_t);
+void ds3231EmulatorSetTemperature(int16_t);
+void ds3231EmulatorSetBatteryPower(bool);
+void ds3231EmulatorSetResponding(bool);
+bool ds3231EmulatorIsInterruptActive(void);
+
+#endif
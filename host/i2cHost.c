@@ -0,0 +1,178 @@
+/*
+   The i2cMaster.h functions for building DS3231.c on a PC. Instead of driving the TWI hardware
+   every bus event is passed to the emulated ds3231 in ds3231Emulator.c, and the virtual clock
+   is advanced by the time the event would take on a real bus at the frequency given to initI2C.
+   Interrupt driven transactions run to completion inside i2cSubmit
+*/
+
+#include "i2cMaster.h"
+#include "ds3231Emulator.h"
+#include <util/delay.h>
+
+#include <stddef.h>
+
+#define NS_PER_SECOND 1000000000ULL
+
+static uint32_t busFrequency = I2C_DEFAULT_FREQUENCY;
+static bool isEmulatorReset = false;
+
+static void advanceBits(uint8_t);
+
+/*
+   resets the emulated ds3231 the first time it is called, so each program starts with a
+   freshly powered ds3231
+	Param: frequency -> the SCL frequency in Hz the bus timing is based on
+	Returns: the frequency
+*/
+uint32_t initI2C(uint32_t frequency)
+{
+	if(!isEmulatorReset)
+	{
+		ds3231EmulatorReset();
+		isEmulatorReset = true;
+	}
+
+	busFrequency = frequency != 0 ? frequency : I2C_DEFAULT_FREQUENCY;
+	return busFrequency;
+}
+
+// the emulated bus never hangs, so there is nothing to time out or recover
+void i2cSetTimeout(uint32_t cycles)
+{
+}
+
+uint8_t i2cGetLastError(void)
+{
+	return 0;
+}
+
+uint16_t i2cGetTimeoutCount(void)
+{
+	return 0;
+}
+
+uint16_t i2cGetRecoveryCount(void)
+{
+	return 0;
+}
+
+uint8_t i2cRecoverBus(void)
+{
+	return 0;
+}
+
+uint8_t i2cStart(uint8_t address)
+{
+	advanceBits(1 + 9); // START, address and ACK
+	return ds3231EmulatorStart(address) ? 0 : 1;
+}
+
+uint8_t i2cRepeatStart(uint8_t address)
+{
+	return i2cStart(address);
+}
+
+uint8_t i2cStartWait(uint8_t address)
+{
+	for(uint8_t attempt = 0; attempt < 100; attempt++)
+	{
+		if(i2cStart(address) == 0)
+			return 0;
+		i2cStop();
+	}
+
+	return 2;
+}
+
+uint8_t i2cStop(void)
+{
+	advanceBits(1);
+	ds3231EmulatorStop();
+	return 0;
+}
+
+uint8_t i2cWrite(uint8_t data)
+{
+	advanceBits(9);
+	return ds3231EmulatorWrite(data) ? 0 : 1;
+}
+
+uint8_t i2cReadAck(void)
+{
+	advanceBits(9);
+	return ds3231EmulatorRead();
+}
+
+uint8_t i2cReadNak(void)
+{
+	advanceBits(9);
+	return ds3231EmulatorRead();
+}
+
+uint8_t i2cRead(uint8_t ack)
+{
+	return ack ? i2cReadAck() : i2cReadNak();
+}
+
+/*
+   runs the transaction straight away, then its callback
+	Returns: 0, the transaction has finished
+*/
+uint8_t i2cSubmit(i2c_transaction_t *transaction)
+{
+	uint8_t status = I2C_TRANSACTION_DONE;
+	// as in the TWI interrupt, a transaction with nothing to write starts with the read address
+	bool isReadOnly = transaction->writeLength == 0 && transaction->readLength != 0;
+
+	if(!isReadOnly)
+	{
+		if(i2cStart(transaction->address & ~I2C_READ) != 0)
+			status = I2C_TRANSACTION_ERROR;
+		for(uint8_t i = 0; status == I2C_TRANSACTION_DONE && i < transaction->writeLength; i++)
+			if(i2cWrite(transaction->writeBuffer[i]) != 0)
+				status = I2C_TRANSACTION_ERROR;
+	}
+
+	if(status == I2C_TRANSACTION_DONE && transaction->readLength != 0)
+	{
+		if(i2cStart(transaction->address | I2C_READ) != 0) // a repeated start if anything was written
+			status = I2C_TRANSACTION_ERROR;
+		for(uint8_t i = 0; status == I2C_TRANSACTION_DONE && i < transaction->readLength; i++)
+			transaction->readBuffer[i] = i + 1 < transaction->readLength ? i2cReadAck() : i2cReadNak();
+	}
+	i2cStop();
+
+	transaction->status = status;
+	if(transaction->callback != NULL)
+		transaction->callback(transaction);
+
+	return 0;
+}
+
+uint8_t i2cIsBusy(void)
+{
+	return 0;
+}
+
+uint8_t i2cWaitForIdle(void)
+{
+	return 0;
+}
+
+/*
+   the _delay_ms and _delay_us of host/util/delay.h, lets virtual time pass
+	Param: microseconds -> how long to wait, a double as in avr-libc
+*/
+void hostDelayUs(double microseconds)
+{
+	if(microseconds > 0)
+		ds3231EmulatorAdvance((uint64_t) (microseconds * 1000));
+}
+
+/*
+   advances the virtual clock by a number of SCL periods
+*/
+static void advanceBits(uint8_t bits)
+{
+	ds3231EmulatorAdvance(bits * NS_PER_SECOND / busFrequency);
+}
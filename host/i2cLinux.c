@@ -0,0 +1,256 @@
+#ifdef __linux__
+
+#include "i2cLinux.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+static uint8_t linuxStart(const i2c_bus_t *, uint8_t);
+static uint8_t linuxWrite(const i2c_bus_t *, uint8_t);
+static uint8_t linuxRead(const i2c_bus_t *, bool);
+static uint8_t linuxStop(const i2c_bus_t *);
+static uint8_t linuxReadRegisters(const i2c_bus_t *, uint8_t, uint8_t, uint8_t *, uint8_t);
+static uint8_t linuxWriteRegisters(const i2c_bus_t *, uint8_t, uint8_t, const uint8_t *, uint8_t);
+static uint8_t linuxSubmit(const i2c_bus_t *, i2c_transaction_t *);
+static uint8_t transfer(i2c_linux_t *, struct i2c_msg *, uint8_t);
+static void clearMessages(i2c_linux_t *);
+static int ioctlTransfer(int, struct i2c_rdwr_ioctl_data *);
+
+/*
+   opens a Linux i2c bus and fills in bus, which can then be passed to e.g. `initDS3231OnBus`:
+
+	static i2c_linux_t device;
+	static i2c_bus_t linuxBus;
+	if(initI2CLinux(&linuxBus, &device, "/dev/i2c-1", NULL) == 0)
+		initDS3231OnBus(&linuxBus);
+
+	Param: bus -> filled in with the operations of the Linux bus
+		   device -> the state of the bus, must stay valid while the bus is used
+		   path -> the i2c-dev device to open, NULL to open none (for a transfer that needs none)
+		   transferFunction -> performs the transfers, NULL for ioctl(fd, I2C_RDWR, data)
+	Returns: 0 on success
+			 1 if the device could not be opened
+*/
+uint8_t initI2CLinux(i2c_bus_t *bus, i2c_linux_t *device, const char *path, i2c_linux_transfer_t transferFunction)
+{
+	*device = (i2c_linux_t) { .fd = -1, .transfer = transferFunction != NULL ? transferFunction : ioctlTransfer };
+	*bus = (i2c_bus_t)
+	{
+		.start = linuxStart,
+		.write = linuxWrite,
+		.read = linuxRead,
+		.stop = linuxStop,
+		.readRegisters = linuxReadRegisters,
+		.writeRegisters = linuxWriteRegisters,
+		.submit = linuxSubmit,
+		.isBusy = NULL, // linuxSubmit runs the transaction straight away
+		.context = device
+	};
+
+	if(path != NULL && (device->fd = open(path, O_RDWR)) < 0)
+		return 1;
+
+	return 0;
+}
+
+/*
+   closes the device opened by `initI2CLinux`
+*/
+void i2cLinuxClose(i2c_linux_t *device)
+{
+	if(device->fd >= 0)
+		close(device->fd);
+	device->fd = -1;
+}
+
+/*
+   begins a new message, nothing is sent yet
+	Returns: 0 on success
+			 1 if too many messages have been collected
+*/
+static uint8_t linuxStart(const i2c_bus_t *bus, uint8_t address)
+{
+	i2c_linux_t *device = bus->context;
+
+	if(device->messageCount == 0 && device->readAddress == 0)
+		device->error = 0;
+	device->readAddress = 0;
+
+	if(device->messageCount >= I2C_LINUX_MAX_MESSAGES)
+	{
+		device->error = 1;
+		return 1;
+	}
+
+	device->messages[device->messageCount++] = (struct i2c_msg)
+	{
+		.addr = address >> 1,
+		.flags = (address & I2C_READ) ? I2C_M_RD : 0,
+		.len = 0,
+		.buf = device->buffer + device->bufferLength
+	};
+
+	return 0;
+}
+
+/*
+   adds a byte to the message begun by the last START
+	Returns: 0 on success
+			 1 if there is no write message or the buffer is full
+*/
+static uint8_t linuxWrite(const i2c_bus_t *bus, uint8_t data)
+{
+	i2c_linux_t *device = bus->context;
+
+	if(device->messageCount == 0 || (device->messages[device->messageCount - 1].flags & I2C_M_RD) || device->bufferLength >= I2C_LINUX_BUFFER_SIZE)
+	{
+		device->error = 1;
+		return 1;
+	}
+
+	device->buffer[device->bufferLength++] = data;
+	device->messages[device->messageCount - 1].len++;
+
+	return 0;
+}
+
+/*
+   reads a byte. The first read after a START sends the collected messages, ending with a one
+   byte read, later reads are one byte transfers of their own. ack is ignored, the kernel NAKs
+   the last byte of every read message
+	Returns: the byte read, 0 on a failure which is reported by the STOP
+*/
+static uint8_t linuxRead(const i2c_bus_t *bus, bool ack)
+{
+	i2c_linux_t *device = bus->context;
+	uint8_t data = 0;
+
+	if(device->messageCount != 0)
+	{
+		struct i2c_msg *message = &device->messages[device->messageCount - 1];
+		if(!(message->flags & I2C_M_RD) || message->len != 0)
+		{
+			device->error = 1;
+			clearMessages(device);
+			return 0;
+		}
+
+		message->buf = &data;
+		message->len = 1;
+		device->readAddress = (message->addr << 1) | I2C_READ;
+		if(transfer(device, device->messages, device->messageCount) != 0)
+			device->error = 1;
+		clearMessages(device);
+	}
+	else if(device->readAddress != 0)
+	{
+		struct i2c_msg message = { .addr = device->readAddress >> 1, .flags = I2C_M_RD, .len = 1, .buf = &data };
+		if(transfer(device, &message, 1) != 0)
+			device->error = 1;
+	}
+	else
+		device->error = 1;
+
+	return data;
+}
+
+/*
+   sends any collected messages as one combined transfer
+	Returns: 0 on success
+			 1 if anything failed since the START
+*/
+static uint8_t linuxStop(const i2c_bus_t *bus)
+{
+	i2c_linux_t *device = bus->context;
+
+	if(device->messageCount != 0 && transfer(device, device->messages, device->messageCount) != 0)
+		device->error = 1;
+	clearMessages(device);
+	device->readAddress = 0;
+
+	uint8_t error = device->error;
+	device->error = 0;
+
+	return error;
+}
+
+/*
+   writes reg then reads count bytes in one combined transfer
+*/
+static uint8_t linuxReadRegisters(const i2c_bus_t *bus, uint8_t address, uint8_t reg, uint8_t *values, uint8_t count)
+{
+	struct i2c_msg messages[2] =
+	{
+		{ .addr = address >> 1, .flags = 0, .len = 1, .buf = &reg },
+		{ .addr = address >> 1, .flags = I2C_M_RD, .len = count, .buf = values }
+	};
+
+	return transfer(bus->context, messages, 2);
+}
+
+/*
+   writes reg and count bytes in one message
+	Returns: 0 on success
+			 1 if the transfer failed or count is more than I2C_LINUX_BUFFER_SIZE - 1
+*/
+static uint8_t linuxWriteRegisters(const i2c_bus_t *bus, uint8_t address, uint8_t reg, const uint8_t *values, uint8_t count)
+{
+	uint8_t buffer[I2C_LINUX_BUFFER_SIZE];
+
+	if(count >= I2C_LINUX_BUFFER_SIZE)
+		return 1;
+
+	buffer[0] = reg;
+	memcpy(buffer + 1, values, count);
+	struct i2c_msg message = { .addr = address >> 1, .flags = 0, .len = count + 1, .buf = buffer };
+
+	return transfer(bus->context, &message, 1);
+}
+
+/*
+   runs the transaction straight away as one combined transfer, then its callback
+	Returns: 0, the transaction has finished
+*/
+static uint8_t linuxSubmit(const i2c_bus_t *bus, i2c_transaction_t *transaction)
+{
+	struct i2c_msg messages[2];
+	uint8_t count = 0;
+
+	if(transaction->writeLength != 0)
+		messages[count++] = (struct i2c_msg) { .addr = transaction->address >> 1, .flags = 0, .len = transaction->writeLength, .buf = (uint8_t *) transaction->writeBuffer };
+	if(transaction->readLength != 0)
+		messages[count++] = (struct i2c_msg) { .addr = transaction->address >> 1, .flags = I2C_M_RD, .len = transaction->readLength, .buf = transaction->readBuffer };
+
+	transaction->status = count == 0 || transfer(bus->context, messages, count) == 0 ? I2C_TRANSACTION_DONE : I2C_TRANSACTION_ERROR;
+	if(transaction->callback != NULL)
+		transaction->callback(transaction);
+
+	return 0;
+}
+
+/*
+	Returns: 0 if the messages were transferred
+			 1 on a failure, e.g. a NAK
+*/
+static uint8_t transfer(i2c_linux_t *device, struct i2c_msg *messages, uint8_t count)
+{
+	struct i2c_rdwr_ioctl_data data = { .msgs = messages, .nmsgs = count };
+
+	return device->transfer(device->fd, &data) < 0 ? 1 : 0;
+}
+
+static void clearMessages(i2c_linux_t *device)
+{
+	device->messageCount = 0;
+	device->bufferLength = 0;
+}
+
+static int ioctlTransfer(int fd, struct i2c_rdwr_ioctl_data *data)
+{
+	return ioctl(fd, I2C_RDWR, data);
+}
+
+#endif
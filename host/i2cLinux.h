@@ -0,0 +1,51 @@
+#ifndef GUARD_I2C_LINUX_H
+#define GUARD_I2C_LINUX_H
+
+#include <stdint.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "i2cBus.h"
+
+/*
+   An i2c_bus_t for /dev/i2c-N on Linux. The register operations and submit are each sent as
+   one I2C_RDWR combined transfer (a write message and a read message with a repeated START
+   between them and one STOP), so DS3231.c needs a single system call per transaction.
+
+   The kernel needs to know the length of every message before the transfer starts, so the
+   byte by byte operations are collected into messages and sent at the STOP, or at the first
+   read after a START, which reads one byte. Any further read is a one byte transfer of its
+   own, with its own START and STOP. Errors, including a NAK of the address or a written byte,
+   are only known once the messages have been sent and are returned by the STOP.
+
+   Transfers go through an i2c_linux_transfer_t, ioctl(fd, I2C_RDWR, data) by default, which
+   can be replaced to test code using the bus against an in-process fake of the device
+*/
+
+// the most messages and bytes collected by the byte by byte operations before they are sent
+#define I2C_LINUX_MAX_MESSAGES 4
+#define I2C_LINUX_BUFFER_SIZE 64
+
+// performs one combined transfer, returns a negative value on failure as ioctl does
+typedef int (*i2c_linux_transfer_t)(int fd, struct i2c_rdwr_ioctl_data *data);
+
+// the state of one /dev/i2c-N bus
+typedef struct
+{
+	int fd; // -1 if no device is open
+	i2c_linux_transfer_t transfer;
+	struct i2c_msg messages[I2C_LINUX_MAX_MESSAGES]; // collected by the byte by byte operations
+	uint8_t buffer[I2C_LINUX_BUFFER_SIZE]; // the data of the collected messages
+	uint8_t messageCount;
+	uint8_t bufferLength;
+	uint8_t readAddress; // the address further reads continue from, 0 if none
+	uint8_t error; // non zero if anything failed since the START, reported by the STOP
+} i2c_linux_t;
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t initI2CLinux(i2c_bus_t *, i2c_linux_t *, const char *, i2c_linux_transfer_t);
+void i2cLinuxClose(i2c_linux_t *);
+
+#endif
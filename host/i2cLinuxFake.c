@@ -0,0 +1,82 @@
+#ifdef __linux__
+
+#include "i2cLinuxFake.h"
+#include "i2cMaster.h"
+#include "ds3231Emulator.h"
+
+#include <stdbool.h>
+#include <errno.h>
+
+#define NS_PER_SECOND 1000000000ULL
+
+static uint32_t transferCount = 0;
+
+static void advanceBits(uint16_t);
+
+/*
+   sends the messages to the emulated ds3231, see i2cLinuxFake.h
+	Param: fd -> ignored, no device is needed
+		   data -> the messages of the combined transfer
+	Returns: the number of messages on success
+			 -1 with errno set to ENXIO if an address was NAKed, or EIO if a written byte was
+*/
+int i2cLinuxFakeTransfer(int fd, struct i2c_rdwr_ioctl_data *data)
+{
+	int error = 0;
+
+	transferCount++;
+	for(uint32_t i = 0; error == 0 && i < data->nmsgs; i++)
+	{
+		const struct i2c_msg *message = &data->msgs[i];
+		bool isRead = (message->flags & I2C_M_RD) != 0;
+
+		advanceBits(1 + 9); // (repeated) START, address and ACK
+		if(!ds3231EmulatorStart((message->addr << 1) | (isRead ? I2C_READ : 0)))
+		{
+			error = ENXIO;
+			break;
+		}
+
+		for(uint16_t j = 0; j < message->len; j++)
+		{
+			advanceBits(9);
+			if(isRead)
+				message->buf[j] = ds3231EmulatorRead();
+			else if(!ds3231EmulatorWrite(message->buf[j]))
+			{
+				error = EIO;
+				break;
+			}
+		}
+	}
+
+	advanceBits(1);
+	ds3231EmulatorStop();
+
+	if(error != 0)
+	{
+		errno = error;
+		return -1;
+	}
+
+	return data->nmsgs;
+}
+
+/*
+   the number of transfers sent since the program started, to check how many system calls a
+   driver function would need
+*/
+uint32_t i2cLinuxFakeGetTransferCount(void)
+{
+	return transferCount;
+}
+
+/*
+   advances the virtual clock by a number of SCL periods
+*/
+static void advanceBits(uint16_t bits)
+{
+	ds3231EmulatorAdvance(bits * NS_PER_SECOND / I2C_DEFAULT_FREQUENCY);
+}
+
+#endif
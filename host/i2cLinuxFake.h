@@ -0,0 +1,28 @@
+#ifndef GUARD_I2C_LINUX_FAKE_H
+#define GUARD_I2C_LINUX_FAKE_H
+
+#include <stdint.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+/*
+   An i2c_linux_transfer_t that passes the messages of every transfer to the emulated ds3231 in
+   ds3231Emulator.c, so the Linux bus of i2cLinux.c can be tested without an i2c-dev device:
+
+	static i2c_linux_t device;
+	static i2c_bus_t linuxBus;
+	initI2CLinux(&linuxBus, &device, NULL, i2cLinuxFakeTransfer);
+	initDS3231OnBus(&linuxBus);
+
+   Each message begins with a (repeated) START and the transfer ends with one STOP, as the kernel
+   sends an I2C_RDWR transfer. The virtual clock is advanced by the time the transfer would take
+   at I2C_DEFAULT_FREQUENCY
+*/
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+int i2cLinuxFakeTransfer(int, struct i2c_rdwr_ioctl_data *);
+uint32_t i2cLinuxFakeGetTransferCount(void);
+
+#endif
@@ -0,0 +1,632 @@
+/*
+   Regression tests of DS3231.c, run against the emulated ds3231. Each test starts with a freshly
+   powered ds3231 in 24 hour mode and checks what the driver reads back as well as the state the
+   emulator is left in (flags, interrupt pin, CONV/BSY), so behaviour the driver can't see by
+   itself is covered too. Every failed check is reported on stderr and the exit status is 1 if
+   any failed, so `make test` fails.
+
+   Every test is run twice, with the ds3231 on the i2cMaster.h bus (host/i2cHost.c) and on the
+   Linux bus of host/i2cLinux.c, whose transfers go to the emulator through host/i2cLinuxFake.c.
+   The linux tests are only run on the latter
+*/
+
+#include "DS3231.h"
+#include "ds3231Emulator.h"
+#include "i2cLinux.h"
+#include "i2cLinuxFake.h"
+
+#include <stdio.h>
+#include <util/delay.h>
+
+#define NS_PER_SECOND 1000000000ULL
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+// a test, run on a freshly powered ds3231
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+} test_t;
+
+// a bus the tests are run on, init sets it up and calls initDS3231 or initDS3231OnBus
+typedef struct
+{
+	const char *name;
+	void (*init)(void);
+} test_bus_t;
+
+static i2c_linux_t linuxDevice;
+static i2c_bus_t linuxBus;
+static const char *currentBus = NULL;
+static const char *currentTest = NULL;
+static unsigned testCount = 0;
+static unsigned checkCount = 0;
+static unsigned failureCount = 0;
+static uint16_t callbackTemperature = 0;
+static uint8_t callbackCount = 0;
+
+static void check(bool, const char *, const char *, int);
+static void advanceSeconds(uint8_t);
+static void startSecondIn(uint64_t);
+static uint64_t getReadTime(void);
+static void onTemperature(uint16_t);
+static void initMasterBus(void);
+static void initLinuxBus(void);
+static void runTests(const test_bus_t *, const test_t *, size_t);
+
+static void testDateTimeRoundTrip(void);
+static void testTimeKeeping(void);
+static void testCenturyRollover(void);
+static void testWriteBackCenturyRollover(void);
+static void test12HourGetHour(void);
+static void testHourRange(void);
+static void testAlarm1Match(void);
+static void testAlarm2EveryMinute(void);
+static void testRemoveAlarm(void);
+static void testAlarmBusError(void);
+static void testOscillatorStopped(void);
+static void testClearAlarmFlagRace(void);
+static void testOscillatorStoppedRace(void);
+static void test32KHzOutput(void);
+static void testTemperatureConversion(void);
+static void testTemperatureWaitsForBusy(void);
+static void testWriteBackFlush(void);
+static void testWriteBackAlarmFlags(void);
+static void testWriteBackOscillatorStopped(void);
+static void testWriteBackTemperature(void);
+static void testLinuxOneTransferPerAccess(void);
+static void testLinuxBytewise(void);
+static void testLinuxRequestDateTime(void);
+static void testLinuxAddressNak(void);
+
+static const test_bus_t masterBus = { "i2cMaster", initMasterBus };
+static const test_bus_t linuxTestBus = { "i2cLinux", initLinuxBus };
+
+static const test_t tests[] =
+{
+	{ "dateTimeRoundTrip", testDateTimeRoundTrip },
+	{ "timeKeeping", testTimeKeeping },
+	{ "centuryRollover", testCenturyRollover },
+	{ "writeBackCenturyRollover", testWriteBackCenturyRollover },
+	{ "12HourGetHour", test12HourGetHour },
+	{ "hourRange", testHourRange },
+	{ "alarm1Match", testAlarm1Match },
+	{ "alarm2EveryMinute", testAlarm2EveryMinute },
+	{ "removeAlarm", testRemoveAlarm },
+	{ "alarmBusError", testAlarmBusError },
+	{ "oscillatorStopped", testOscillatorStopped },
+	{ "clearAlarmFlagRace", testClearAlarmFlagRace },
+	{ "oscillatorStoppedRace", testOscillatorStoppedRace },
+	{ "32KHzOutput", test32KHzOutput },
+	{ "temperatureConversion", testTemperatureConversion },
+	{ "temperatureWaitsForBusy", testTemperatureWaitsForBusy },
+	{ "writeBackFlush", testWriteBackFlush },
+	{ "writeBackAlarmFlags", testWriteBackAlarmFlags },
+	{ "writeBackOscillatorStopped", testWriteBackOscillatorStopped },
+	{ "writeBackTemperature", testWriteBackTemperature }
+};
+
+static const test_t linuxTests[] =
+{
+	{ "linuxOneTransferPerAccess", testLinuxOneTransferPerAccess },
+	{ "linuxBytewise", testLinuxBytewise },
+	{ "linuxRequestDateTime", testLinuxRequestDateTime },
+	{ "linuxAddressNak", testLinuxAddressNak }
+};
+
+int main(void)
+{
+	runTests(&masterBus, tests, sizeof(tests) / sizeof(tests[0]));
+	runTests(&linuxTestBus, tests, sizeof(tests) / sizeof(tests[0]));
+	runTests(&linuxTestBus, linuxTests, sizeof(linuxTests) / sizeof(linuxTests[0]));
+
+	printf("%u checks in %u tests, %u failed\n", checkCount, testCount, failureCount);
+
+	return failureCount != 0 ? 1 : 0;
+}
+
+static void check(bool condition, const char *text, const char *file, int line)
+{
+	checkCount++;
+	if(condition)
+		return;
+
+	failureCount++;
+	fprintf(stderr, "%s:%d: %s on %s: CHECK(%s) failed\n", file, line, currentTest, currentBus, text);
+}
+
+// runs each test on a freshly powered ds3231 on the bus
+static void runTests(const test_bus_t *testBus, const test_t *busTests, size_t count)
+{
+	currentBus = testBus->name;
+	for(size_t i = 0; i < count; i++)
+	{
+		currentTest = busTests[i].name;
+		testCount++;
+
+		ds3231EmulatorReset();
+		ds3231Use12HourMode(false);
+		ds3231SetCentury(21);
+		testBus->init();
+		busTests[i].run();
+		ds3231UseWriteBack(false);
+	}
+}
+
+static void initMasterBus(void)
+{
+	initDS3231();
+}
+
+// no i2c-dev device is opened, every transfer goes to the emulator
+static void initLinuxBus(void)
+{
+	initI2CLinux(&linuxBus, &linuxDevice, NULL, i2cLinuxFakeTransfer);
+	initDS3231OnBus(&linuxBus);
+}
+
+// lets whole seconds pass on the emulated ds3231
+static void advanceSeconds(uint8_t seconds)
+{
+	ds3231EmulatorAdvance(seconds * NS_PER_SECOND);
+}
+
+// lets time pass until the next second of the emulated ds3231 starts in (to within a microsecond) ns
+static void startSecondIn(uint64_t ns)
+{
+	uint8_t second = ds3231EmulatorGetRegister(DS3231_REGISTER_SECONDS);
+	while(ds3231EmulatorGetRegister(DS3231_REGISTER_SECONDS) == second)
+		ds3231EmulatorAdvance(1000);
+
+	ds3231EmulatorAdvance(NS_PER_SECOND - ns - 1000);
+}
+
+// the time a single register read takes on the bus, such as the STATUS read of a read-modify-write
+static uint64_t getReadTime(void)
+{
+	uint64_t start = ds3231EmulatorGetTime();
+	ds3231GetSecond();
+
+	return ds3231EmulatorGetTime() - start;
+}
+
+static void onTemperature(uint16_t temperature)
+{
+	callbackTemperature = temperature;
+	callbackCount++;
+}
+
+static void testDateTimeRoundTrip(void)
+{
+	datetime_t set = { .second = 45, .minute = 30, .hour = 21, .day = WEDNESDAY, .date = 28, .month = DECEMBER, .year = 16, .century = 21 };
+	datetime_t read;
+
+	CHECK(ds3231SetDateTime(&set) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231GetDateTime(&read) == DS3231_OPERATION_SUCCESS);
+	CHECK(read.second == 45 && read.minute == 30 && read.hour == 21 && !read.isPM);
+	CHECK(read.day == WEDNESDAY && read.date == 28 && read.month == DECEMBER && read.year == 16 && read.century == 21);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == 0x21);
+
+	char text[DS3231_DATETIME_STRING_LENGTH];
+	CHECK(ds3231GetDateTimeString(text) == DS3231_OPERATION_SUCCESS);
+	CHECK(text[0] == '2' && text[3] == '6' && text[11] == '2' && text[12] == '1' && text[18] == '5');
+}
+
+static void testTimeKeeping(void)
+{
+	CHECK(ds3231SetFullDate(MONDAY, 28, FEBRUARY, 24, 21) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231SetTime(23, 59, 58, false) == DS3231_OPERATION_SUCCESS);
+	advanceSeconds(1);
+	CHECK(ds3231GetSecond() == 59);
+
+	advanceSeconds(1); // 2024 is a leap year
+	datetime_t read;
+	ds3231GetDateTime(&read);
+	CHECK(read.hour == 0 && read.minute == 0 && read.second == 0);
+	CHECK(read.day == TUESDAY && read.date == 29 && read.month == FEBRUARY);
+}
+
+static void testCenturyRollover(void)
+{
+	datetime_t set = { .second = 59, .minute = 59, .hour = 23, .day = FRIDAY, .date = 31, .month = DECEMBER, .year = 99, .century = 21 };
+	ds3231SetDateTime(&set);
+	advanceSeconds(1);
+
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY) & DS3231_CENTURY_BIT);
+	CHECK(ds3231GetCentury() == 22);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY) & DS3231_CENTURY_BIT));
+	CHECK(ds3231GetCentury() == 22); // counted once
+	CHECK(ds3231GetYear() == 0 && ds3231GetMonth() == JANUARY);
+
+	// setting the month clears the CENTURY bit, it must be counted first
+	uint8_t month = ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY);
+	ds3231EmulatorSetRegister(DS3231_REGISTER_MONTH_CENTURY, month | DS3231_CENTURY_BIT);
+	CHECK(ds3231SetMonth(MARCH) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY) == 0x03);
+	CHECK(ds3231GetCentury() == 23);
+}
+
+// the CENTURY bit is cleared straight away, as the ds3231 keeps reporting it until then
+static void testWriteBackCenturyRollover(void)
+{
+	datetime_t set = { .second = 59, .minute = 59, .hour = 23, .day = FRIDAY, .date = 31, .month = DECEMBER, .year = 99, .century = 21 };
+	datetime_t read;
+	char text[DS3231_DATETIME_STRING_LENGTH];
+
+	ds3231SetDateTime(&set);
+	ds3231UseWriteBack(true);
+	advanceSeconds(1);
+
+	CHECK(ds3231GetMonth() == JANUARY);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY) & DS3231_CENTURY_BIT));
+	CHECK(ds3231GetMonth() == JANUARY);
+	CHECK(ds3231GetDateTime(&read) == DS3231_OPERATION_SUCCESS);
+	CHECK(read.century == 22 && read.year == 0);
+	CHECK(ds3231GetDateTimeString(text) == DS3231_OPERATION_SUCCESS);
+	CHECK(text[0] == '2' && text[1] == '1' && text[2] == '0' && text[3] == '0');
+	CHECK(ds3231GetCentury() == 22);
+
+	// a pending month write is sent with the cleared bit, not replaced by the month read
+	ds3231SetDateTime(&set);
+	ds3231Flush();
+	CHECK(ds3231SetMonth(MARCH) == DS3231_OPERATION_SUCCESS);
+	advanceSeconds(1);
+	CHECK(ds3231GetCentury() == 22);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_MONTH_CENTURY) == 0x03);
+}
+
+// ds3231GetHour used to return the raw register, e.g. 52 for 12 PM
+static void test12HourGetHour(void)
+{
+	ds3231Use12HourMode(true);
+	CHECK(ds3231SetTime(12, 30, 0, true) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == (DS3231_HOUR_MODE_12_BIT | DS3231_PM_BIT | 0x12));
+	CHECK(ds3231GetHour() == 12);
+
+	CHECK(ds3231SetTime(11, 59, 59, true) == DS3231_OPERATION_SUCCESS);
+	advanceSeconds(1); // 11:59:59 PM -> 12:00:00 AM
+	CHECK(ds3231GetHour() == 12);
+
+	datetime_t read;
+	ds3231GetDateTime(&read);
+	CHECK(read.hour == 12 && !read.isPM);
+
+	CHECK(ds3231SetHour(9, true) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231GetHour() == 9);
+	ds3231GetDateTime(&read);
+	CHECK(read.hour == 9 && read.isPM);
+}
+
+// ds3231SetHour and ds3231SetTime/ds3231SetDateTime accept the same hours
+static void testHourRange(void)
+{
+	CHECK(ds3231SetHour(0, false) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231SetHour(23, false) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231SetHour(24, false) == 1);
+	CHECK(ds3231SetTime(24, 0, 0, false) == 1);
+
+	ds3231Use12HourMode(true);
+	CHECK(ds3231SetHour(7, false) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231SetHour(0, false) == 2);
+	CHECK(ds3231SetHour(13, false) == 2);
+	CHECK(ds3231SetTime(0, 0, 0, false) == 2);
+	CHECK(ds3231SetTime(13, 0, 0, false) == 2);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == (DS3231_HOUR_MODE_12_BIT | 0x07));
+}
+
+static void testAlarm1Match(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .second = 5, .minute = 0, .hour = 8, .trigger = A1_HOUR_MIN_SEC_MATCH };
+
+	ds3231SetTime(8, 0, 0, false);
+	CHECK(ds3231SetAlarm(&alarm) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_A1IE_BIT);
+
+	advanceSeconds(4);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+	advanceSeconds(1);
+	CHECK(ds3231EmulatorIsInterruptActive());
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_A1F_BIT);
+
+	CHECK(ds3231ClearAlarmFlags() == DS3231_STATUS_A1F_BIT);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+	CHECK(ds3231ClearAlarmFlags() == 0);
+
+	advanceSeconds(60); // the minutes and hours must match as well
+	CHECK(!ds3231EmulatorIsInterruptActive());
+}
+
+static void testAlarm2EveryMinute(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_2, .trigger = A2_EVERY_MIN };
+
+	ds3231SetTime(8, 0, 58, false);
+	CHECK(ds3231SetAlarm(&alarm) == DS3231_OPERATION_SUCCESS);
+
+	advanceSeconds(1);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+	advanceSeconds(1);
+	CHECK(ds3231EmulatorIsInterruptActive());
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_A2F_BIT);
+
+	CHECK(ds3231ClearAlarmFlag(ALARM_2) == DS3231_OPERATION_SUCCESS);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+}
+
+static void testRemoveAlarm(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .trigger = A1_EVERY_SEC };
+
+	ds3231SetAlarm(&alarm);
+	advanceSeconds(1);
+	CHECK(ds3231EmulatorIsInterruptActive());
+
+	CHECK(ds3231RemoveAlarm(ALARM_1) == DS3231_OPERATION_SUCCESS);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_A1IE_BIT));
+	advanceSeconds(1);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+}
+
+// a ds3231 that doesn't answer is reported, and STATUS is never written back from a failed read
+static void testAlarmBusError(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_2, .trigger = A2_EVERY_MIN };
+	uint8_t status = ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS);
+
+	ds3231EmulatorSetResponding(false);
+	CHECK(ds3231SetAlarm(&alarm) == 13);
+	CHECK(ds3231RemoveAlarm(ALARM_1) == 2);
+	CHECK(ds3231ClearAlarmFlag(ALARM_1) == 2);
+	CHECK(ds3231Disable32KhzOutput() == 2);
+	CHECK(!ds3231HasOscillatorStopped());
+	ds3231EmulatorSetResponding(true);
+
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_A2IE_BIT));
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) == status);
+	CHECK(ds3231SetAlarm(&alarm) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_A2IE_BIT);
+	CHECK(ds3231HasOscillatorStopped());
+}
+
+static void testOscillatorStopped(void)
+{
+	CHECK(ds3231HasOscillatorStopped()); // set at power on
+	CHECK(!ds3231HasOscillatorStopped());
+
+	ds3231SetTime(10, 0, 0, false);
+	ds3231EmulatorSetBatteryPower(true); // keeps running on battery by default
+	advanceSeconds(2);
+	ds3231EmulatorSetBatteryPower(false);
+	CHECK(ds3231GetSecond() == 2);
+	CHECK(!ds3231HasOscillatorStopped());
+
+	CHECK(ds3231DisableOscillatorOnBattery() == DS3231_OPERATION_SUCCESS);
+	ds3231EmulatorSetBatteryPower(true);
+	advanceSeconds(3);
+	ds3231EmulatorSetBatteryPower(false);
+	CHECK(ds3231GetSecond() == 2);
+	CHECK(ds3231HasOscillatorStopped());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_OSF_BIT));
+}
+
+// alarm 1 triggers after ds3231ClearAlarmFlag has read STATUS but before it writes it back
+static void testClearAlarmFlagRace(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .trigger = A1_EVERY_SEC };
+
+	ds3231SetAlarm(&alarm);
+	uint64_t readTime = getReadTime();
+	startSecondIn(readTime + 10000);
+	uint8_t status = ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS);
+	ds3231EmulatorSetRegister(DS3231_REGISTER_STATUS, (status & ~DS3231_STATUS_A1F_BIT) | DS3231_STATUS_A2F_BIT);
+
+	CHECK(ds3231ClearAlarmFlag(ALARM_2) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_A1F_BIT);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_A2F_BIT));
+	CHECK(ds3231EmulatorIsInterruptActive());
+}
+
+// as testClearAlarmFlagRace, for the write clearing OSF
+static void testOscillatorStoppedRace(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .trigger = A1_EVERY_SEC };
+
+	ds3231SetAlarm(&alarm);
+	uint64_t readTime = getReadTime();
+	startSecondIn(readTime + 10000);
+	uint8_t status = ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS);
+	ds3231EmulatorSetRegister(DS3231_REGISTER_STATUS, (status & ~DS3231_STATUS_A1F_BIT) | DS3231_STATUS_OSF_BIT);
+
+	CHECK(ds3231HasOscillatorStopped());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_OSF_BIT));
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_A1F_BIT);
+	CHECK(ds3231EmulatorIsInterruptActive());
+}
+
+// changing EN32kHz must leave the alarm flags alone
+static void test32KHzOutput(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .trigger = A1_EVERY_SEC };
+
+	ds3231SetAlarm(&alarm);
+	advanceSeconds(1);
+	CHECK(ds3231Disable32KhzOutput() == DS3231_OPERATION_SUCCESS);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_EN32KHZ_BIT));
+	CHECK(ds3231EmulatorIsInterruptActive());
+
+	ds3231ClearAlarmFlags();
+	CHECK(ds3231Enable32KHzOutput() == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_EN32KHZ_BIT);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+	advanceSeconds(1);
+	CHECK(ds3231EmulatorIsInterruptActive());
+}
+
+static void testTemperatureConversion(void)
+{
+	callbackCount = 0;
+	ds3231EmulatorSetTemperature(-1075);
+
+	CHECK(ds3231StartTemperatureConversion(onTemperature) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_BSY_BIT);
+	CHECK(ds3231StartTemperatureConversion(NULL) == 1);
+	CHECK(!ds3231IsTemperatureReady());
+
+	_delay_ms(DS3231_TEMPERATURE_CONVERSION_MS);
+	CHECK(ds3231IsTemperatureReady());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT));
+	CHECK(callbackCount == 1);
+	CHECK(ds3231TemperatureToHundredths(callbackTemperature) == -1075);
+	CHECK(ds3231GetTemperatureHundredths() == -1075);
+
+	ds3231EmulatorSetTemperature(2525);
+	ds3231ForceTemperatureUpdate();
+	CHECK(ds3231GetTemperatureHundredths() == 2525);
+}
+
+// CONV must not be set while the ds3231 is busy with a conversion of its own
+static void testTemperatureWaitsForBusy(void)
+{
+	uint8_t status = ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS);
+	ds3231EmulatorSetRegister(DS3231_REGISTER_STATUS, status | DS3231_STATUS_BSY_BIT);
+
+	CHECK(ds3231StartTemperatureConversion(NULL) == DS3231_OPERATION_SUCCESS);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT));
+	CHECK(!ds3231IsTemperatureReady());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT));
+
+	ds3231EmulatorSetRegister(DS3231_REGISTER_STATUS, status & ~DS3231_STATUS_BSY_BIT);
+	CHECK(!ds3231IsTemperatureReady());
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT);
+
+	while(!ds3231IsTemperatureReady())
+		_delay_ms(DS3231_TEMPERATURE_POLL_INTERVAL_MS);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT));
+}
+
+static void testWriteBackFlush(void)
+{
+	ds3231UseWriteBack(true);
+	CHECK(ds3231SetTime(8, 30, 0, false) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231SetAgingOffset(-3) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231GetAgingOffset() == -3);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == 0);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_AGING_OFFSET) == 0);
+	CHECK(ds3231GetHour() == 0); // the time keeping registers are read from the ds3231
+
+	CHECK(ds3231Flush() == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == 0x08);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_AGING_OFFSET) == (uint8_t) -3);
+	CHECK(ds3231GetHour() == 8);
+}
+
+// STATUS is written straight away, so flags raised before the flush survive it
+static void testWriteBackAlarmFlags(void)
+{
+	alarm_t alarm = { .alarmNumber = ALARM_1, .trigger = A1_EVERY_SEC };
+
+	ds3231UseWriteBack(true);
+	CHECK(ds3231SetAlarm(&alarm) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_A1IE_BIT);
+
+	advanceSeconds(1);
+	CHECK(ds3231EmulatorIsInterruptActive());
+	CHECK(ds3231ClearAlarmFlag(ALARM_1) == DS3231_OPERATION_SUCCESS);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+
+	ds3231SetAgingOffset(1); // something to flush
+	advanceSeconds(1);
+	CHECK(ds3231Flush() == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorIsInterruptActive());
+	CHECK(ds3231ClearAlarmFlags() == DS3231_STATUS_A1F_BIT);
+	CHECK(!ds3231EmulatorIsInterruptActive());
+}
+
+static void testWriteBackOscillatorStopped(void)
+{
+	ds3231UseWriteBack(true);
+	CHECK(ds3231HasOscillatorStopped());
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS) & DS3231_STATUS_OSF_BIT));
+
+	uint8_t status = ds3231EmulatorGetRegister(DS3231_REGISTER_STATUS);
+	ds3231EmulatorSetRegister(DS3231_REGISTER_STATUS, status | DS3231_STATUS_OSF_BIT);
+	CHECK(ds3231HasOscillatorStopped());
+	CHECK(!ds3231HasOscillatorStopped());
+}
+
+// a pending CONTROL write must not hide CONV from the conversion poll
+static void testWriteBackTemperature(void)
+{
+	ds3231UseWriteBack(true);
+	CHECK(ds3231StartTemperatureConversion(NULL) == DS3231_OPERATION_SUCCESS);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT);
+
+	ds3231DisableOscillatorOnBattery(); // CONTROL is now dirty
+	CHECK(!ds3231IsTemperatureReady());
+	_delay_ms(DS3231_TEMPERATURE_CONVERSION_MS);
+	CHECK(ds3231IsTemperatureReady());
+
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_EOSC_BIT));
+	ds3231Flush();
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_EOSC_BIT);
+	CHECK(!(ds3231EmulatorGetRegister(DS3231_REGISTER_CONTROL) & DS3231_CONTROL_CONV_BIT));
+}
+
+// each register access is a single I2C_RDWR transfer, a single system call on Linux
+static void testLinuxOneTransferPerAccess(void)
+{
+	datetime_t set = { .second = 10, .minute = 20, .hour = 13, .day = SUNDAY, .date = 5, .month = MAY, .year = 24, .century = 21 };
+	datetime_t read;
+
+	uint32_t transfers = i2cLinuxFakeGetTransferCount();
+	CHECK(ds3231SetDateTime(&set) == DS3231_OPERATION_SUCCESS);
+	CHECK(i2cLinuxFakeGetTransferCount() == transfers + 1);
+
+	transfers = i2cLinuxFakeGetTransferCount();
+	CHECK(ds3231GetDateTime(&read) == DS3231_OPERATION_SUCCESS);
+	CHECK(i2cLinuxFakeGetTransferCount() == transfers + 1);
+	CHECK(read.hour == 13 && read.minute == 20 && read.date == 5 && read.month == MAY && read.year == 24);
+}
+
+// the byte by byte operations are collected into messages and sent at the first read or the STOP
+static void testLinuxBytewise(void)
+{
+	const uint8_t set[] = { 0x56, 0x34, 0x12 };
+	uint8_t read[3] = { 0 };
+
+	CHECK(i2cBusWriteRegistersBytewise(&linuxBus, DS3231_ADDRESS_WRITE, DS3231_REGISTER_SECONDS, set, 3) == 0);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_SECONDS) == 0x56);
+	CHECK(ds3231EmulatorGetRegister(DS3231_REGISTER_HOURS) == 0x12);
+
+	CHECK(i2cBusReadRegistersBytewise(&linuxBus, DS3231_ADDRESS_WRITE, DS3231_REGISTER_SECONDS, read, 3) == 0);
+	CHECK(read[0] == 0x56 && read[1] == 0x34 && read[2] == 0x12);
+	CHECK(ds3231GetHour() == 12);
+}
+
+// submit runs the transaction straight away, so the bus is never busy
+static void testLinuxRequestDateTime(void)
+{
+	i2c_transaction_t transaction;
+	uint8_t registers[DS3231_DATETIME_REGISTER_COUNT];
+	datetime_t read;
+
+	ds3231SetTime(6, 7, 8, false);
+	CHECK(ds3231RequestDateTime(&transaction, registers, NULL) == 0);
+	CHECK(transaction.status == I2C_TRANSACTION_DONE);
+	CHECK(!ds3231IsBusy());
+	CHECK(ds3231DecodeDateTime(registers, &read) == DS3231_OPERATION_SUCCESS);
+	CHECK(read.hour == 6 && read.minute == 7 && read.second == 8);
+}
+
+// a NAK of the address fails the transfer, which the bus reports as an error
+static void testLinuxAddressNak(void)
+{
+	uint8_t value = 0;
+
+	CHECK(i2cBusReadRegisters(&linuxBus, 0b10100000, 0, &value, 1) != 0);
+	CHECK(i2cBusReadRegistersBytewise(&linuxBus, 0b10100000, 0, &value, 1) != 0);
+	CHECK(ds3231GetMinute() == 0); // the bus is usable afterwards
+}
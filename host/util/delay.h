@@ -0,0 +1,13 @@
+#ifndef GUARD_HOST_UTIL_DELAY_H
+#define GUARD_HOST_UTIL_DELAY_H
+
+#include <stdint.h>
+
+// the avr-libc delays for the host build, they let the virtual clock of the emulated ds3231
+// run on instead of waiting (see host/i2cHost.c)
+void hostDelayUs(double);
+
+#define _delay_ms(ms) hostDelayUs((ms) * 1000.0)
+#define _delay_us(us) hostDelayUs(us)
+
+#endif
@@ -0,0 +1,142 @@
+#include "i2cBus.h"
+
+#include <stddef.h>
+
+/*
+   reads consecutive registers of a device in one transaction, with the bus's own burst read if
+   it has one
+	Param: bus -> the bus the device is on
+		   address -> the write address of the device
+		   reg -> the first register to read
+		   values -> buffer the count register values are stored in
+		   count -> the number of registers to read, at least 1
+	Returns: 0 on success
+			 non zero if the device did not respond or the bus failed
+*/
+uint8_t i2cBusReadRegisters(const i2c_bus_t *bus, uint8_t address, uint8_t reg, uint8_t *values, uint8_t count)
+{
+	if(bus->readRegisters != NULL)
+		return bus->readRegisters(bus, address, reg, values, count);
+
+	return i2cBusReadRegistersBytewise(bus, address, reg, values, count);
+}
+
+/*
+   writes consecutive registers of a device in one transaction, with the bus's own burst write
+   if it has one
+	Param: bus -> the bus the device is on
+		   address -> the write address of the device
+		   reg -> the first register to write
+		   values -> the count values to write, values[0] goes to reg
+		   count -> the number of registers to write
+	Returns: 0 on success
+			 non zero if the device did not respond or the bus failed
+*/
+uint8_t i2cBusWriteRegisters(const i2c_bus_t *bus, uint8_t address, uint8_t reg, const uint8_t *values, uint8_t count)
+{
+	if(bus->writeRegisters != NULL)
+		return bus->writeRegisters(bus, address, reg, values, count);
+
+	return i2cBusWriteRegistersBytewise(bus, address, reg, values, count);
+}
+
+/*
+   queues a transaction on a bus that can run them in the background, otherwise runs it
+   straight away. Either way its status is set and its callback run once it has finished
+	Param: bus -> the bus to use
+		   transaction -> see i2cSubmit
+	Returns: 0 if the transaction was queued or has been run
+			 1 if the transaction is already queued or running
+*/
+uint8_t i2cBusSubmit(const i2c_bus_t *bus, i2c_transaction_t *transaction)
+{
+	if(bus->submit != NULL)
+		return bus->submit(bus, transaction);
+
+	uint8_t status = I2C_TRANSACTION_DONE;
+	// a transaction with nothing to write starts with the read address
+	bool isReadOnly = transaction->writeLength == 0 && transaction->readLength != 0;
+
+	if(!isReadOnly)
+	{
+		if(bus->start(bus, transaction->address & ~I2C_READ) != 0)
+			status = I2C_TRANSACTION_ERROR;
+		for(uint8_t i = 0; status == I2C_TRANSACTION_DONE && i < transaction->writeLength; i++)
+			if(bus->write(bus, transaction->writeBuffer[i]) != 0)
+				status = I2C_TRANSACTION_ERROR;
+	}
+
+	if(status == I2C_TRANSACTION_DONE && transaction->readLength != 0)
+	{
+		if(bus->start(bus, transaction->address | I2C_READ) != 0)
+			status = I2C_TRANSACTION_ERROR;
+		for(uint8_t i = 0; status == I2C_TRANSACTION_DONE && i < transaction->readLength; i++)
+			transaction->readBuffer[i] = bus->read(bus, i + 1 < transaction->readLength);
+	}
+	if(bus->stop(bus) != 0)
+		status = I2C_TRANSACTION_ERROR;
+
+	transaction->status = status;
+	if(transaction->callback != NULL)
+		transaction->callback(transaction);
+
+	return 0;
+}
+
+/*
+   checks whether transactions submitted with i2cBusSubmit are still queued or running, e.g.
+   before the AVR is put to sleep
+	Param: bus -> the bus to check
+	Returns: 0 if the bus is idle, always on a bus that runs transactions straight away
+			 1 if transactions are queued or running
+*/
+uint8_t i2cBusIsBusy(const i2c_bus_t *bus)
+{
+	if(bus->isBusy == NULL)
+		return 0;
+
+	return bus->isBusy(bus);
+}
+
+/*
+   see i2cBusReadRegisters. Sends START, the write address and reg, then a repeated START and
+   the read address, reads count bytes and sends a STOP. On a failure the bus is released with
+   a STOP
+*/
+uint8_t i2cBusReadRegistersBytewise(const i2c_bus_t *bus, uint8_t address, uint8_t reg, uint8_t *values, uint8_t count)
+{
+	if(bus->start(bus, address & ~I2C_READ) != 0 || bus->write(bus, reg) != 0 || bus->start(bus, address | I2C_READ) != 0)
+	{
+		bus->stop(bus);
+		return 1;
+	}
+
+	for(uint8_t i = 0; i < count; i++)
+		values[i] = bus->read(bus, i + 1 < count);
+
+	return bus->stop(bus) != 0 ? 1 : 0;
+}
+
+/*
+   see i2cBusWriteRegisters. Sends START, the write address, reg and the values, then a STOP.
+   On a failure the bus is released with a STOP
+*/
+uint8_t i2cBusWriteRegistersBytewise(const i2c_bus_t *bus, uint8_t address, uint8_t reg, const uint8_t *values, uint8_t count)
+{
+	if(bus->start(bus, address & ~I2C_READ) != 0 || bus->write(bus, reg) != 0)
+	{
+		bus->stop(bus);
+		return 1;
+	}
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		if(bus->write(bus, values[i]) != 0)
+		{
+			bus->stop(bus);
+			return 1;
+		}
+	}
+
+	return bus->stop(bus) != 0 ? 1 : 0;
+}
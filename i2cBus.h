@@ -0,0 +1,62 @@
+#ifndef GUARD_I2C_BUS_H
+#define GUARD_I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "i2cMaster.h"
+
+/*
+   The operations of an i2c bus, so a driver can run on any i2c master:
+
+	i2cMasterBus  -> the i2cMaster.h functions, the TWI hardware (or the emulator on a PC)
+	i2cSoftware.c -> bit-banged on any two AVR pins
+	i2cLinux.c    -> /dev/i2c-N on Linux, in host/
+
+   Addresses are 8 bit, the 7 bit address shifted left with the direction in bit 0 (e.g.
+   DS3231_ADDRESS_WRITE), as in i2cMaster.h. Every operation returns 0 on success. The
+   register (burst) operations and submit may be NULL, they are then made out of start, write,
+   read and stop by the i2cBus* functions below, which drivers should call instead of the
+   burst operations themselves
+*/
+
+typedef struct i2c_bus i2c_bus_t;
+
+struct i2c_bus
+{
+	// sends a START, or a repeated START if the bus is still held, and the address
+	uint8_t (*start)(const i2c_bus_t *bus, uint8_t address);
+	// sends a byte, returns 0 on ACK
+	uint8_t (*write)(const i2c_bus_t *bus, uint8_t data);
+	// reads a byte, sending ACK to ask for more or NAK before a STOP
+	uint8_t (*read)(const i2c_bus_t *bus, bool ack);
+	// sends a STOP, returns non zero if anything went wrong since the START
+	uint8_t (*stop)(const i2c_bus_t *bus);
+	// writes reg, then reads count bytes after a repeated START
+	uint8_t (*readRegisters)(const i2c_bus_t *bus, uint8_t address, uint8_t reg, uint8_t *values, uint8_t count);
+	// writes reg followed by count bytes
+	uint8_t (*writeRegisters)(const i2c_bus_t *bus, uint8_t address, uint8_t reg, const uint8_t *values, uint8_t count);
+	// queues a transaction, see i2cSubmit
+	uint8_t (*submit)(const i2c_bus_t *bus, i2c_transaction_t *transaction);
+	// returns non zero while submitted transactions are queued or running, see i2cIsBusy. May
+	// be NULL if submit (or the lack of it) always runs the transaction straight away
+	uint8_t (*isBusy)(const i2c_bus_t *bus);
+	void *context; // the state of the backend
+};
+
+// the i2cMaster.h functions, initI2C must be called before use
+extern const i2c_bus_t i2cMasterBus;
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t i2cBusReadRegisters(const i2c_bus_t *, uint8_t, uint8_t, uint8_t *, uint8_t);
+uint8_t i2cBusWriteRegisters(const i2c_bus_t *, uint8_t, uint8_t, const uint8_t *, uint8_t);
+uint8_t i2cBusSubmit(const i2c_bus_t *, i2c_transaction_t *);
+uint8_t i2cBusIsBusy(const i2c_bus_t *);
+
+// the register operations made out of start, write, read and stop
+uint8_t i2cBusReadRegistersBytewise(const i2c_bus_t *, uint8_t, uint8_t, uint8_t *, uint8_t);
+uint8_t i2cBusWriteRegistersBytewise(const i2c_bus_t *, uint8_t, uint8_t, const uint8_t *, uint8_t);
+
+#endif
@@ -7,8 +7,11 @@
  * Usage:    API compatible with I2C Software Library i2cmaster.h
  **************************************************************************/
 #include <inttypes.h>
+#include <stddef.h>
 #include <compat/twi.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "i2cMaster.h"
 
@@ -17,34 +20,246 @@
 #define F_CPU 8000000UL
 #endif
 
-/* I2C clock in Hz */
-#define SCL_CLOCK  100000L
+#include <util/delay.h>
+
+/* lowest usable TWBR value. Older devices (ATmega8/16/32/64/128 and the like) need at least 10
+   in master mode, on those initI2C returns the lower frequency this gives. The ATmega48/88/168/328
+   (the atmega328 of the Makefile) have no such limit, an 8 MHz F_CPU reaches 400 kHz with TWBR = 2 */
+#ifndef I2C_MIN_TWBR
+#if defined(__AVR_ATmega8__) || defined(__AVR_ATmega16__) || defined(__AVR_ATmega32__) || \
+	defined(__AVR_ATmega64__) || defined(__AVR_ATmega128__) || defined(__AVR_ATmega163__) || \
+	defined(__AVR_ATmega323__) || defined(__AVR_ATmega8535__)
+#define I2C_MIN_TWBR 10
+#else
+#define I2C_MIN_TWBR 0
+#endif
+#endif
+
+/* default timeout of every bus wait, in byte transfer times at the configured SCL frequency */
+#ifndef I2C_TIMEOUT_BYTES
+#define I2C_TIMEOUT_BYTES 8
+#endif
+
+/* approximate number of CPU cycles taken by one pass of a bounded wait loop */
+#define I2C_CYCLES_PER_POLL 8
+
+/* times i2cStartWait polls a busy device before giving up */
+#ifndef I2C_START_WAIT_ATTEMPTS
+#define I2C_START_WAIT_ATTEMPTS 100
+#endif
+
+/* pins used by i2cRecoverBus, the defaults are the TWI pins of the ATmega8/48/88/168/328 */
+#ifndef I2C_RECOVERY_DDR
+#define I2C_RECOVERY_DDR  DDRC
+#define I2C_RECOVERY_PORT PORTC
+#define I2C_RECOVERY_PIN  PINC
+#define I2C_RECOVERY_SCL  PC5
+#define I2C_RECOVERY_SDA  PC4
+#endif
+
+/* half of the SCL period used while recovering the bus, 5 us gives the 100 kHz Standard-mode */
+#ifndef I2C_RECOVERY_HALF_PERIOD_US
+#define I2C_RECOVERY_HALF_PERIOD_US 5
+#endif
+
+/* bus wait limit in polls (0 = wait forever), last recorded error and health counters */
+static uint16_t timeoutPolls = 0xFFFF;
+static volatile uint8_t lastError = 0;
+static volatile uint16_t timeoutCount = 0;
+static volatile uint16_t recoveryCount = 0;
+
+/* interrupt driven transaction queue, the head is the transaction on the bus */
+static i2c_transaction_t * volatile queueHead = NULL;
+static i2c_transaction_t *queueTail = NULL;
+static volatile uint8_t transferIndex; /* bytes written or read of the current part */
+static volatile uint8_t busEvents; /* incremented by every TWI interrupt, used to detect a stalled queue */
+
+static void startTransaction(void);
+static void finishTransaction(uint8_t status);
+static void abortQueue(void);
+static uint8_t waitForInterruptFlag(void);
+static uint8_t waitForStop(void);
+static uint8_t handleTimeout(void);
 
 /*************************************************************************
   Initialization of the I2C bus interface. Need to be called only once
+  SCL frequency = F_CPU / (16 + 2 * TWBR * prescaler)
+
+Input:   target SCL frequency in Hz
+Return:  the SCL frequency in Hz actually achieved
+ *************************************************************************/
+uint32_t initI2C(uint32_t frequency)
+{
+	uint32_t divider = 0; /* 2 * TWBR * prescaler */
+	uint8_t twps;
+
+	if(frequency > 0 && F_CPU / frequency > 16)
+		divider = (F_CPU + frequency - 1) / frequency - 16; /* round up so SCL is never above the target */
+
+	/* use the smallest prescaler that lets TWBR fit in 8 bits, for the finest resolution */
+	for(twps = 0; twps < 3; twps++)
+	{
+		if(divider <= 2UL * 255 << (2 * twps))
+			break;
+	}
+
+	uint32_t step = 2UL << (2 * twps); /* 2 * prescaler */
+	uint32_t twbr = (divider + step - 1) / step;
+	if(twbr > 255)
+		twbr = 255;
+	if(twbr < I2C_MIN_TWBR)
+		twbr = I2C_MIN_TWBR;
+
+	TWSR = twps;                      /* TWPS1:0 are the low bits of TWSR */
+	TWBR = (uint8_t) twbr;
+
+	/* one byte and its ACK take 9 SCL periods */
+	i2cSetTimeout(I2C_TIMEOUT_BYTES * 9 * (16 + twbr * step));
+
+	return F_CPU / (16 + twbr * step);
+}
+
+/*************************************************************************
+  Sets how long every wait for the TWI hardware may take before it is 
+  treated as a hung bus. initI2C sets a default of I2C_TIMEOUT_BYTES byte 
+  times, so call this afterwards to override it
+
+Input:   timeout in CPU cycles (approximate), 0 waits forever
  *************************************************************************/
-void initI2C(void)
+void i2cSetTimeout(uint32_t cycles)
 {
-	/* initialize TWI clock: 100 kHz clock, TWPS = 0 => prescaler = 1 */
-	TWSR = 0;                         /* no prescaler */
-	TWBR = ((F_CPU/SCL_CLOCK)-16)/2;  /* must be > 10 for stable operation */
+	uint32_t polls = cycles / I2C_CYCLES_PER_POLL;
+
+	if(cycles == 0)
+		polls = 0;
+	else if(polls == 0)
+		polls = 1;
+	else if(polls > 0xFFFF)
+		polls = 0xFFFF;
+
+	timeoutPolls = (uint16_t) polls;
+}
+
+/*************************************************************************
+  Return:  the error recorded by the blocking functions since the last 
+  call (0 or I2C_ERROR_TIMEOUT), the error is cleared
+ *************************************************************************/
+uint8_t i2cGetLastError(void)
+{
+	uint8_t error;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		error = lastError;
+		lastError = 0;
+	}
+
+	return error;
+}
+
+/*************************************************************************
+  Return:  number of bus waits that have timed out since power on
+ *************************************************************************/
+uint16_t i2cGetTimeoutCount(void)
+{
+	uint16_t count;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = timeoutCount;
+	}
+
+	return count;
+}
+
+/*************************************************************************
+  Return:  number of times i2cRecoverBus has run since power on
+ *************************************************************************/
+uint16_t i2cGetRecoveryCount(void)
+{
+	uint16_t count;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = recoveryCount;
+	}
+
+	return count;
+}
+
+/*************************************************************************
+  Frees a bus held by a slave stuck part way through a byte. The TWI is 
+  disabled and SCL is clocked by hand, up to 9 times, until the slave 
+  releases SDA, then a STOP condition is generated and the TWI re-enabled.
+  Both lines are driven open drain, low by switching the pin to an output
+  and high by switching it back to an input and relying on the pull-ups
+
+Return:  0 the bus is free
+1 SDA or SCL is still held low
+ *************************************************************************/
+uint8_t i2cRecoverBus(void)
+{
+	const uint8_t scl = 1 << I2C_RECOVERY_SCL;
+	const uint8_t sda = 1 << I2C_RECOVERY_SDA;
+	uint8_t released;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		uint8_t pullUps = I2C_RECOVERY_PORT & (scl | sda);
+
+		recoveryCount++;
+
+		TWCR = 0; /* hand the pins back to the port */
+		I2C_RECOVERY_DDR &= ~(scl | sda);
+		I2C_RECOVERY_PORT &= ~(scl | sda);
+		_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+		for(uint8_t i = 0; i < 9 && !(I2C_RECOVERY_PIN & sda); i++)
+		{
+			I2C_RECOVERY_DDR |= scl;
+			_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+			I2C_RECOVERY_DDR &= ~scl;
+			_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+		}
+
+		/* STOP condition, SDA rises while SCL is high */
+		I2C_RECOVERY_DDR |= scl;
+		_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+		I2C_RECOVERY_DDR |= sda;
+		_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+		I2C_RECOVERY_DDR &= ~scl;
+		_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+		I2C_RECOVERY_DDR &= ~sda;
+		_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+		released = (I2C_RECOVERY_PIN & scl) && (I2C_RECOVERY_PIN & sda);
+
+		I2C_RECOVERY_PORT |= pullUps;
+		TWCR = (1 << TWEN);
+	}
+
+	return released ? 0 : 1;
 }
 
 /*************************************************************************	
   Issues a start condition and sends address and transfer direction.
   return 0 = device accessible, 1= start condition didn't transmit, 
-  2= master as transmitter/receiver didn't receive an ACK
+  2= master as transmitter/receiver didn't receive an ACK,
+  I2C_ERROR_TIMEOUT = the bus hung and was recovered
  *************************************************************************/
 uint8_t i2cStart(uint8_t address)
 {
 	uint8_t twst;
 
+	if(i2cWaitForIdle())
+		return I2C_ERROR_TIMEOUT;
+
 	// send START condition
 	TWCR = (1 << TWINT | 1 << TWSTA | 1 << TWEN);
 
 	// wait until transmission completed
-	while(!(TWCR & (1 << TWINT)))
-		;
+	if(waitForInterruptFlag())
+		return I2C_ERROR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits.
 	twst = TW_STATUS & 0xF8;
@@ -56,8 +271,8 @@ uint8_t i2cStart(uint8_t address)
 	TWCR = (1 << TWINT | 1 << TWEN);
 
 	// wail until transmission completed and ACK/NACK has been received
-	while(!(TWCR & (1 << TWINT)))
-		;
+	if(waitForInterruptFlag())
+		return I2C_ERROR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits.
 	twst = TW_STATUS & 0xF8;
@@ -73,19 +288,25 @@ uint8_t i2cStart(uint8_t address)
   If device is busy, use ack polling to wait until device is ready
 
 Input:   address and transfer direction of I2C device
+Return:  0 device accessible
+2 device still busy after I2C_START_WAIT_ATTEMPTS polls
+I2C_ERROR_TIMEOUT the bus hung and was recovered
  *************************************************************************/
-void i2cStartWait(uint8_t address)
+uint8_t i2cStartWait(uint8_t address)
 {
 	uint8_t twst;
 
-	while (1)
+	if(i2cWaitForIdle())
+		return I2C_ERROR_TIMEOUT;
+
+	for(uint8_t attempt = 0; attempt < I2C_START_WAIT_ATTEMPTS; attempt++)
 	{
 		// send START condition
 		TWCR = (1 << TWINT | 1 << TWSTA | 1 << TWEN);
 
 		// wait until transmission completed
-		while(!(TWCR & (1 << TWINT)))
-			;
+		if(waitForInterruptFlag())
+			return I2C_ERROR_TIMEOUT;
 
 		// check value of TWI Status Register. Mask prescaler bits.
 		twst = TW_STATUS & 0xF8;
@@ -97,24 +318,23 @@ void i2cStartWait(uint8_t address)
 		TWCR = (1 << TWINT | 1 << TWEN);
 
 		// wail until transmission completed
-		while(!(TWCR & (1 << TWINT)))
-			;
+		if(waitForInterruptFlag())
+			return I2C_ERROR_TIMEOUT;
 
 		// check value of TWI Status Register. Mask prescaler bits.
 		twst = TW_STATUS & 0xF8;
 		if((twst == TW_MT_SLA_NACK) || (twst ==TW_MR_DATA_NACK)) 
 		{    	    
 			/* device busy, send stop condition to terminate write operation */
-			TWCR = (1 << TWINT | 1 << TWEN | 1 << TWSTO);
-
-			// wait until stop condition is executed and bus released
-			while(TWCR & (1 << TWSTO))
-				;
+			if(i2cStop())
+				return I2C_ERROR_TIMEOUT;
 			continue;
 		}
 
-		break;
+		return 0;
 	}
+
+	return 2;
 }
 
 /*************************************************************************
@@ -132,15 +352,17 @@ uint8_t i2cRepeatStart(uint8_t address)
 
 /*************************************************************************
   Terminates the data transfer and releases the I2C bus
+
+Return:  0 bus released
+I2C_ERROR_TIMEOUT the bus hung and was recovered
  *************************************************************************/
-void i2cStop(void)
+uint8_t i2cStop(void)
 {
 	/* send stop condition */
 	TWCR = (1 << TWINT | 1 << TWEN | 1 << TWSTO);
 
 	// wait until stop condition is executed and bus released
-	while(TWCR & (1 << TWSTO))
-		;
+	return waitForStop();
 }
 
 /*************************************************************************
@@ -149,6 +371,7 @@ void i2cStop(void)
 Input:    byte to be transfered
 Return:   0 write successful 
 1 write failed
+I2C_ERROR_TIMEOUT the bus hung and was recovered
  *************************************************************************/
 uint8_t i2cWrite(uint8_t data)
 {	
@@ -159,8 +382,8 @@ uint8_t i2cWrite(uint8_t data)
 	TWCR = (1 << TWINT | 1 << TWEN);
 
 	// wait until transmission completed
-	while(!(TWCR & (1 << TWINT)))
-		;
+	if(waitForInterruptFlag())
+		return I2C_ERROR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits
 	twst = TW_STATUS & 0xF8;
@@ -173,13 +396,13 @@ uint8_t i2cWrite(uint8_t data)
 /*************************************************************************
   Read one byte from the I2C device, request more data from device 
 
-Return:  byte read from I2C device
+Return:  byte read from I2C device, 0 if the bus hung (see i2cGetLastError)
  *************************************************************************/
 uint8_t i2cReadAck(void)
 {
 	TWCR = (1 << TWINT | 1 << TWEN | 1 << TWEA);
-	while(!(TWCR & (1 << TWINT)))
-		;    
+	if(waitForInterruptFlag())
+		return 0;
 
 	return TWDR;
 }
@@ -187,13 +410,271 @@ uint8_t i2cReadAck(void)
 /*************************************************************************
   Read one byte from the I2C device, read is followed by a stop condition 
 
-Return:  byte read from I2C device
+Return:  byte read from I2C device, 0 if the bus hung (see i2cGetLastError)
  *************************************************************************/
 uint8_t i2cReadNak(void)
 {
 	TWCR = (1 << TWINT | 1 << TWEN);
-	while(!(TWCR & (1 << TWINT)))
-		;
+	if(waitForInterruptFlag())
+		return 0;
 
 	return TWDR;
 }
+
+/*************************************************************************
+  Queues a transaction to be run by the TWI interrupt. Starts the bus 
+  straight away if the queue was empty
+
+Input:   the transaction descriptor
+Return:  0 transaction queued
+1 transaction is already queued or running
+ *************************************************************************/
+uint8_t i2cSubmit(i2c_transaction_t *transaction)
+{
+	if(transaction->status >= I2C_TRANSACTION_QUEUED)
+		return 1;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		transaction->status = I2C_TRANSACTION_QUEUED;
+		transaction->next = NULL;
+
+		if(queueHead == NULL)
+		{
+			queueHead = transaction;
+			queueTail = transaction;
+			startTransaction();
+		}
+		else
+		{
+			queueTail->next = transaction;
+			queueTail = transaction;
+		}
+	}
+
+	return 0;
+}
+
+/*************************************************************************
+  Return:  1 if interrupt driven transactions are queued or running, 0 otherwise
+ *************************************************************************/
+uint8_t i2cIsBusy(void)
+{
+	return queueHead != NULL;
+}
+
+/*************************************************************************
+  Blocks until the transaction queue is empty and the final STOP 
+  condition has been sent. If the queue makes no progress for the timeout
+  the bus is recovered and every queued transaction fails
+
+Return:  0 bus idle
+I2C_ERROR_TIMEOUT the queue stalled and was aborted
+ *************************************************************************/
+uint8_t i2cWaitForIdle(void)
+{
+	uint16_t polls = timeoutPolls;
+	uint8_t events = busEvents;
+
+	while(queueHead != NULL)
+	{
+		if(busEvents != events)
+		{
+			// the queue is moving, restart the timeout
+			events = busEvents;
+			polls = timeoutPolls;
+		}
+		else if(polls != 0 && --polls == 0)
+		{
+			uint8_t error = handleTimeout();
+			abortQueue();
+			return error;
+		}
+	}
+
+	// wait until stop condition is executed and bus released
+	return waitForStop();
+}
+
+/*************************************************************************
+  Waits for TWINT, recovering the bus if it does not arrive in time
+
+Return:  0 TWINT set
+I2C_ERROR_TIMEOUT the bus hung and was recovered
+ *************************************************************************/
+static uint8_t waitForInterruptFlag(void)
+{
+	uint16_t polls = timeoutPolls;
+
+	while(!(TWCR & (1 << TWINT)))
+	{
+		if(polls != 0 && --polls == 0)
+			return handleTimeout();
+	}
+
+	return 0;
+}
+
+/*************************************************************************
+  Waits for a STOP condition to finish, recovering the bus if it does not
+  finish in time
+
+Return:  0 bus released
+I2C_ERROR_TIMEOUT the bus hung and was recovered
+ *************************************************************************/
+static uint8_t waitForStop(void)
+{
+	uint16_t polls = timeoutPolls;
+
+	while(TWCR & (1 << TWSTO))
+	{
+		if(polls != 0 && --polls == 0)
+			return handleTimeout();
+	}
+
+	return 0;
+}
+
+/*************************************************************************
+  Records a timed out wait and frees the bus
+
+Return:  I2C_ERROR_TIMEOUT
+ *************************************************************************/
+static uint8_t handleTimeout(void)
+{
+	timeoutCount++;
+	lastError = I2C_ERROR_TIMEOUT;
+	i2cRecoverBus();
+
+	return I2C_ERROR_TIMEOUT;
+}
+
+/*************************************************************************
+  Fails every queued transaction, used once a stalled bus has been 
+  recovered. Callbacks are run with interrupts disabled as they would be 
+  from the TWI interrupt
+ *************************************************************************/
+static void abortQueue(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		i2c_transaction_t *transaction = queueHead;
+
+		queueHead = NULL;
+		queueTail = NULL;
+		while(transaction != NULL)
+		{
+			i2c_transaction_t *next = transaction->next;
+
+			transaction->status = I2C_TRANSACTION_ERROR;
+			if(transaction->callback != NULL)
+				transaction->callback(transaction);
+			transaction = next;
+		}
+	}
+}
+
+/*************************************************************************
+  Issues the START condition for the transaction at the head of the queue
+ *************************************************************************/
+static void startTransaction(void)
+{
+	// a STOP issued by the interrupt may still be in progress
+	waitForStop();
+
+	transferIndex = 0;
+	queueHead->status = I2C_TRANSACTION_BUSY;
+	TWCR = (1 << TWINT | 1 << TWSTA | 1 << TWEN | 1 << TWIE);
+}
+
+/*************************************************************************
+  Completes the transaction at the head of the queue, then either starts
+  the next one (STOP followed by START) or releases the bus
+ *************************************************************************/
+static void finishTransaction(uint8_t status)
+{
+	i2c_transaction_t *finished = queueHead;
+
+	queueHead = finished->next;
+	if(queueHead != NULL)
+	{
+		transferIndex = 0;
+		queueHead->status = I2C_TRANSACTION_BUSY;
+		TWCR = (1 << TWINT | 1 << TWSTO | 1 << TWSTA | 1 << TWEN | 1 << TWIE);
+	}
+	else
+	{
+		queueTail = NULL;
+		TWCR = (1 << TWINT | 1 << TWSTO | 1 << TWEN);
+	}
+
+	finished->status = status;
+	if(finished->callback != NULL)
+		finished->callback(finished);
+}
+
+/*************************************************************************
+  TWI state machine, runs once per bus event of the transaction at the 
+  head of the queue
+ *************************************************************************/
+ISR(TWI_vect)
+{
+	i2c_transaction_t *transaction = queueHead;
+
+	busEvents++;
+
+	switch(TW_STATUS & 0xF8)
+	{
+		case TW_START:
+			// a transaction with nothing to read starts with the write address, even if empty
+			if(transaction->writeLength || !transaction->readLength)
+				TWDR = transaction->address & ~I2C_READ;
+			else
+				TWDR = transaction->address | I2C_READ;
+			TWCR = (1 << TWINT | 1 << TWEN | 1 << TWIE);
+			break;
+
+		case TW_REP_START:
+			TWDR = transaction->address | I2C_READ;
+			TWCR = (1 << TWINT | 1 << TWEN | 1 << TWIE);
+			break;
+
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if(transferIndex < transaction->writeLength)
+			{
+				TWDR = transaction->writeBuffer[transferIndex++];
+				TWCR = (1 << TWINT | 1 << TWEN | 1 << TWIE);
+			}
+			else if(transaction->readLength)
+			{
+				// switch to reading with a repeated start
+				transferIndex = 0;
+				TWCR = (1 << TWINT | 1 << TWSTA | 1 << TWEN | 1 << TWIE);
+			}
+			else
+			{
+				finishTransaction(I2C_TRANSACTION_DONE);
+			}
+			break;
+
+		case TW_MR_DATA_ACK:
+			transaction->readBuffer[transferIndex++] = TWDR;
+			// fall through, ACK every byte but the last
+		case TW_MR_SLA_ACK:
+			if(transferIndex + 1 < transaction->readLength)
+				TWCR = (1 << TWINT | 1 << TWEA | 1 << TWEN | 1 << TWIE);
+			else
+				TWCR = (1 << TWINT | 1 << TWEN | 1 << TWIE);
+			break;
+
+		case TW_MR_DATA_NACK: // last byte received
+			transaction->readBuffer[transferIndex++] = TWDR;
+			finishTransaction(I2C_TRANSACTION_DONE);
+			break;
+
+		default: // address or data NACKed, arbitration lost or bus error
+			finishTransaction(I2C_TRANSACTION_ERROR);
+			break;
+	}
+}
@@ -1,5 +1,5 @@
 #ifndef GUARD_I2CMASTER_H
-#define GUARDG_I2CMASTER_H
+#define GUARD_I2CMASTER_H
 /************************************************************************* 
 * Title:    C include file for the I2C master interface 
 *           (i2cmaster.S or twimaster.c)
@@ -57,17 +57,71 @@
 /** defines the data direction (writing to I2C device) in i2c_start(),i2c_rep_start() */
 #define I2C_WRITE   0
 
+/** returned by the blocking functions when the bus hung and had to be recovered, see @ref i2cRecoverBus */
+#define I2C_ERROR_TIMEOUT 3
+
+/** default bus frequency in Hz, the DS3231 supports 400 kHz Fast-mode */
+#ifndef I2C_DEFAULT_FREQUENCY
+#define I2C_DEFAULT_FREQUENCY 400000UL
+#endif
+
 /**
  @brief initialize the I2C master interace. Need to be called only once 
- @return none
+
+ Picks the smallest TWI prescaler (1, 4, 16 or 64) and bit rate register value that give a
+ SCL frequency as close as possible to, but not above, the one requested for the F_CPU in use.
+ @param    frequency the target SCL frequency in Hz, e.g. 100000 or 400000
+ @return   the SCL frequency in Hz actually achieved
+ */
+uint32_t initI2C(uint32_t frequency);
+
+/**
+ @brief set the timeout of every wait for the TWI hardware
+
+ Each blocking function waits at most this long per bus event (START, address, byte or STOP)
+ before the bus is treated as hung, recovered with @ref i2cRecoverBus and @ref I2C_ERROR_TIMEOUT
+ returned. This bounds the worst case time of every call. @ref initI2C sets a default of
+ 8 byte times at the chosen frequency, call this afterwards to change it.
+ @param    cycles the timeout in CPU cycles (approximate), 0 waits forever
+ @return   none
+ */
+void i2cSetTimeout(uint32_t cycles);
+
+/**
+ @brief    get and clear the error recorded by the blocking functions
+
+ Useful after @ref i2cReadAck and @ref i2cReadNak, which cannot return an error.
+ @retval   0 no bus wait has timed out since the last call
+ @retval   I2C_ERROR_TIMEOUT a bus wait timed out and the bus was recovered
+ */
+uint8_t i2cGetLastError(void);
+
+/**
+ @brief    number of bus waits that have timed out since power on
+ */
+uint16_t i2cGetTimeoutCount(void);
+
+/**
+ @brief    number of times @ref i2cRecoverBus has run since power on
+ */
+uint16_t i2cGetRecoveryCount(void);
+
+/**
+ @brief    free a bus held low by a slave that lost track of a transfer
+
+ Disables the TWI, clocks SCL up to 9 times until SDA is released, generates a STOP condition
+ and re-enables the TWI. Called automatically when a wait times out.
+ @retval   0 the bus is free
+ @retval   1 SDA or SCL is still held low
  */
-void initI2C(void);
+uint8_t i2cRecoverBus(void);
 
 /** 
  @brief Terminates the data transfer and releases the I2C bus 
- @return none
+ @retval   0 bus released
+ @retval   I2C_ERROR_TIMEOUT the bus hung and was recovered
  */
-void i2cStop(void);
+uint8_t i2cStop(void);
 
 /** 
  @brief Issues a start condition and sends address and transfer direction 
@@ -75,6 +129,7 @@ void i2cStop(void);
  @param    addr address and transfer direction of I2C device
  @retval   0   device accessible 
  @retval   1   failed to access device 
+ @retval   I2C_ERROR_TIMEOUT the bus hung and was recovered
  */
 uint8_t i2cStart(uint8_t addr);
 
@@ -92,27 +147,30 @@ uint8_t i2cRepeatStart(uint8_t addr);
    
  If device is busy, use ack polling to wait until device ready 
  @param    addr address and transfer direction of I2C device
- @return   none
+ @retval   0 device accessible
+ @retval   2 device still busy after I2C_START_WAIT_ATTEMPTS polls
+ @retval   I2C_ERROR_TIMEOUT the bus hung and was recovered
  */
-void i2cStartWait(uint8_t addr);
+uint8_t i2cStartWait(uint8_t addr);
  
 /**
  @brief Send one byte to I2C device
  @param    data  byte to be transfered
  @retval   0 write successful
  @retval   1 write failed
+ @retval   I2C_ERROR_TIMEOUT the bus hung and was recovered
  */
 uint8_t i2cWrite(uint8_t data);
 
 /**
  @brief    read one byte from the I2C device, request more data from device 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0 if the bus hung (see @ref i2cGetLastError)
  */
 uint8_t i2cReadAck(void);
 
 /**
  @brief    read one byte from the I2C device, read is followed by a stop condition 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0 if the bus hung (see @ref i2cGetLastError)
  */
 uint8_t i2cReadNak(void);
 
@@ -127,6 +185,68 @@ uint8_t i2cReadNak(void);
  */
 uint8_t i2cRead(uint8_t ack);
 
+/** @ref i2c_transaction_t status: finished successfully (or never submitted) */
+#define I2C_TRANSACTION_DONE     0
+/** @ref i2c_transaction_t status: finished with an error (NACK, arbitration lost or bus error) */
+#define I2C_TRANSACTION_ERROR    1
+/** @ref i2c_transaction_t status: waiting in the queue */
+#define I2C_TRANSACTION_QUEUED   2
+/** @ref i2c_transaction_t status: currently on the bus */
+#define I2C_TRANSACTION_BUSY     3
+
+typedef struct i2c_transaction i2c_transaction_t;
+
+/**
+ @brief descriptor for an interrupt driven transaction, see @ref i2cSubmit
+
+ The writeBuffer is sent first, then a repeated start is issued and readLength bytes are
+ read into readBuffer. Either part may be empty. The descriptor and both buffers are owned
+ by the caller and must stay valid until the transaction has finished. Zero initialise a
+ descriptor before its first use.
+ */
+struct i2c_transaction
+{
+	uint8_t address;                        /**< device address with the write direction bit, e.g. 0b11010000 */
+	const uint8_t *writeBuffer;             /**< bytes to send, may be NULL if writeLength is 0 */
+	uint8_t writeLength;                    /**< number of bytes to send */
+	uint8_t *readBuffer;                    /**< buffer received bytes are stored in, may be NULL if readLength is 0 */
+	uint8_t readLength;                     /**< number of bytes to receive */
+	void (*callback)(i2c_transaction_t *);  /**< called from the TWI interrupt once finished, may be NULL */
+	volatile uint8_t status;                /**< one of the I2C_TRANSACTION_* values */
+	i2c_transaction_t *next;                /**< used internally to link the queue */
+};
+
+/**
+ @brief queue a transaction to be run in the background by the TWI interrupt
+
+ Returns straight away. The transaction's status becomes @ref I2C_TRANSACTION_DONE or
+ @ref I2C_TRANSACTION_ERROR and its callback is run (from interrupt context) once it has finished.
+ Global interrupts must be enabled. The blocking functions wait for the queue to empty before
+ touching the bus, so both can be used in the same program, but they must not be called
+ from a callback. A callback may submit another transaction.
+ @param    transaction the transaction to queue
+ @retval   0 transaction queued
+ @retval   1 transaction is already queued or running
+ */
+uint8_t i2cSubmit(i2c_transaction_t *transaction);
+
+/**
+ @brief    check whether interrupt driven transactions are queued or running
+ @retval   0 the queue is empty and the bus is free
+ @retval   1 transactions are queued or running
+ */
+uint8_t i2cIsBusy(void);
+
+/**
+ @brief    blocks until every queued transaction has finished
+
+ If the queue makes no progress within the timeout (see @ref i2cSetTimeout) the bus is
+ recovered and every queued transaction finishes with @ref I2C_TRANSACTION_ERROR.
+ @retval   0 the bus is idle
+ @retval   I2C_ERROR_TIMEOUT the queue stalled and was aborted
+ */
+uint8_t i2cWaitForIdle(void);
+
 /**@}*/
 
 #endif
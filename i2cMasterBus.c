@@ -0,0 +1,74 @@
+/*
+   i2cMasterBus, the i2c_bus_t of the i2cMaster.h functions: the TWI hardware on the AVR,
+   host/i2cHost.c on a PC. Its traffic is counted by i2cProfile.c when I2C_PROFILE is set
+*/
+
+#include "i2cBus.h"
+#include "i2cMaster.h"
+#include "i2cProfile.h"
+
+#include <stddef.h>
+
+static uint8_t masterStart(const i2c_bus_t *, uint8_t);
+static uint8_t masterWrite(const i2c_bus_t *, uint8_t);
+static uint8_t masterRead(const i2c_bus_t *, bool);
+static uint8_t masterStop(const i2c_bus_t *);
+static uint8_t masterReadRegisters(const i2c_bus_t *, uint8_t, uint8_t, uint8_t *, uint8_t);
+static uint8_t masterSubmit(const i2c_bus_t *, i2c_transaction_t *);
+static uint8_t masterIsBusy(const i2c_bus_t *);
+
+const i2c_bus_t i2cMasterBus =
+{
+	.start = masterStart,
+	.write = masterWrite,
+	.read = masterRead,
+	.stop = masterStop,
+	.readRegisters = masterReadRegisters,
+	.writeRegisters = NULL,
+	.submit = masterSubmit,
+	.isBusy = masterIsBusy,
+	.context = NULL
+};
+
+static uint8_t masterStart(const i2c_bus_t *bus, uint8_t address)
+{
+	return i2cStart(address);
+}
+
+static uint8_t masterWrite(const i2c_bus_t *bus, uint8_t data)
+{
+	return i2cWrite(data);
+}
+
+static uint8_t masterRead(const i2c_bus_t *bus, bool ack)
+{
+	return ack ? i2cReadAck() : i2cReadNak();
+}
+
+static uint8_t masterStop(const i2c_bus_t *bus)
+{
+	return i2cStop();
+}
+
+/*
+   i2cReadAck and i2cReadNak can't return an error, so a read that timed out is only seen in
+   i2cGetLastError. Errors left over from earlier transfers are discarded first
+*/
+static uint8_t masterReadRegisters(const i2c_bus_t *bus, uint8_t address, uint8_t reg, uint8_t *values, uint8_t count)
+{
+	i2cGetLastError();
+	if(i2cBusReadRegistersBytewise(bus, address, reg, values, count) != 0 || i2cGetLastError() != 0)
+		return 1;
+
+	return 0;
+}
+
+static uint8_t masterSubmit(const i2c_bus_t *bus, i2c_transaction_t *transaction)
+{
+	return i2cSubmit(transaction);
+}
+
+static uint8_t masterIsBusy(const i2c_bus_t *bus)
+{
+	return i2cIsBusy();
+}
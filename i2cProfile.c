@@ -0,0 +1,362 @@
+#define I2C_PROFILE_IMPLEMENTATION // the wrappers call the real i2cMaster.h functions
+#include "i2cProfile.h"
+
+#if I2C_PROFILE
+
+#include <stddef.h>
+
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#else
+#include <time.h>
+#endif
+
+#define UNTAGGED 0 // the entry charged with the traffic outside any scope
+#define NAME_LENGTH 32 // the most characters of a tag name dumped
+
+static const char untaggedName[] PROGMEM = "(untagged)";
+static const char dumpHeader[] PROGMEM = "tag,calls,transactions,starts,bytes,us\r\n";
+
+static i2c_profile_entry_t entries[1 + I2C_PROFILE_MAX_TAGS] = { [UNTAGGED] = { .name = untaggedName } };
+static uint8_t entryCount = 1;
+static uint8_t currentTag = UNTAGGED;
+
+#ifdef __AVR__
+// number of times TCNT0 has wrapped, the upper bits of the time
+static volatile uint32_t timerOverflows = 0;
+#endif
+
+static uint8_t findEntry(const char *);
+static uint32_t readClock(void);
+static void charge(uint32_t, uint8_t, uint8_t);
+static char *copyName(char *, const char *);
+static char *appendNumber(char *, uint32_t);
+
+/*
+   clears the counts and starts the clock. On the AVR this takes over Timer0, counting at
+   F_CPU / 8 with an overflow interrupt
+*/
+void initI2CProfile(void)
+{
+#ifdef __AVR__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		timerOverflows = 0;
+		TCCR0A = 0; // normal mode
+		TCNT0 = 0;
+		TIFR0 = (1 << TOV0);
+		TIMSK0 = (1 << TOIE0);
+		TCCR0B = (1 << CS01);
+	}
+#endif
+
+	i2cProfileReset();
+}
+
+/*
+   clears the counts of every tag, the tags seen so far keep their place in the table
+*/
+void i2cProfileReset(void)
+{
+	for(uint8_t i = 0; i < entryCount; i++)
+	{
+		entries[i].calls = 0;
+		entries[i].transactions = 0;
+		entries[i].starts = 0;
+		entries[i].bytes = 0;
+		entries[i].ticks = 0;
+	}
+}
+
+/*
+   start of an I2C_PROFILE_SCOPE. Only the outermost scope changes the tag being charged
+	Param: name -> the tag, in program memory
+	Returns: the tag charged before, restored by i2cProfileLeave
+*/
+uint8_t i2cProfileEnter(const char *name)
+{
+	uint8_t previous = currentTag;
+	if(previous == UNTAGGED)
+	{
+		currentTag = findEntry(name);
+		entries[currentTag].calls++;
+	}
+
+	return previous;
+}
+
+/*
+   end of an I2C_PROFILE_SCOPE, called when the scope variable goes out of scope
+	Param: previous -> the scope variable, holding the value i2cProfileEnter returned
+*/
+void i2cProfileLeave(uint8_t *previous)
+{
+	currentTag = *previous;
+}
+
+/*
+	Returns: the number of entries in the table, including "(untagged)"
+*/
+uint8_t i2cProfileGetEntryCount(void)
+{
+	return entryCount;
+}
+
+/*
+	Param: index -> the entry, 0 is "(untagged)" and the tags follow in the order first seen
+	Returns: the counts of the entry, NULL if there is no such entry
+*/
+const i2c_profile_entry_t *i2cProfileGetEntry(uint8_t index)
+{
+	return index < entryCount ? &entries[index] : NULL;
+}
+
+/*
+   adds up the counts of every entry
+	Param: total -> filled with the sums, its name is set to NULL
+*/
+void i2cProfileGetTotal(i2c_profile_entry_t *total)
+{
+	*total = (i2c_profile_entry_t) { .name = NULL };
+	for(uint8_t i = 0; i < entryCount; i++)
+	{
+		total->calls += entries[i].calls;
+		total->transactions += entries[i].transactions;
+		total->starts += entries[i].starts;
+		total->bytes += entries[i].bytes;
+		total->ticks += entries[i].ticks;
+	}
+}
+
+/*
+   prints the table as comma separated lines, one line for every tag with any calls or traffic
+   after a header line. The time is in microseconds
+	Param: print -> prints a string, e.g. usartPrintString
+*/
+void i2cProfileDump(void (*print)(const char *))
+{
+	char line[NAME_LENGTH + 5 * 11 + 3];
+
+	*copyName(line, dumpHeader) = '\0';
+	print(line);
+
+	for(uint8_t i = 0; i < entryCount; i++)
+	{
+		const i2c_profile_entry_t *entry = &entries[i];
+		if(entry->calls == 0 && entry->starts == 0)
+			continue;
+
+		char *end = copyName(line, entry->name);
+		*end++ = ',';
+		end = appendNumber(end, entry->calls);
+		*end++ = ',';
+		end = appendNumber(end, entry->transactions);
+		*end++ = ',';
+		end = appendNumber(end, entry->starts);
+		*end++ = ',';
+		end = appendNumber(end, entry->bytes);
+		*end++ = ',';
+		end = appendNumber(end, (uint64_t) entry->ticks * I2C_PROFILE_TICK_NS / 1000);
+		*end++ = '\r';
+		*end++ = '\n';
+		*end = '\0';
+		print(line);
+	}
+}
+
+uint8_t i2cProfiledStart(uint8_t address)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cStart(address);
+	charge(start, 1, 0);
+
+	return result;
+}
+
+uint8_t i2cProfiledRepeatStart(uint8_t address)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cRepeatStart(address);
+	charge(start, 1, 0);
+
+	return result;
+}
+
+uint8_t i2cProfiledStartWait(uint8_t address)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cStartWait(address);
+	charge(start, 1, 0);
+
+	return result;
+}
+
+uint8_t i2cProfiledWrite(uint8_t data)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cWrite(data);
+	charge(start, 0, 1);
+
+	return result;
+}
+
+uint8_t i2cProfiledRead(uint8_t ack)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cRead(ack);
+	charge(start, 0, 1);
+
+	return result;
+}
+
+uint8_t i2cProfiledReadAck(void)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cReadAck();
+	charge(start, 0, 1);
+
+	return result;
+}
+
+uint8_t i2cProfiledReadNak(void)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cReadNak();
+	charge(start, 0, 1);
+
+	return result;
+}
+
+uint8_t i2cProfiledStop(void)
+{
+	uint32_t start = readClock();
+	uint8_t result = i2cStop();
+	charge(start, 0, 0);
+	entries[currentTag].transactions++;
+
+	return result;
+}
+
+/*
+   counts the STARTs and bytes of a transaction when it is queued, its time is not counted
+*/
+uint8_t i2cProfiledSubmit(i2c_transaction_t *transaction)
+{
+	i2c_profile_entry_t *entry = &entries[currentTag];
+	entry->transactions++;
+	entry->starts += (transaction->writeLength != 0) + (transaction->readLength != 0);
+	entry->bytes += transaction->writeLength + transaction->readLength;
+
+	return i2cSubmit(transaction);
+}
+
+#ifdef __AVR__
+ISR(TIMER0_OVF_vect)
+{
+	timerOverflows++;
+}
+#endif
+
+/*
+   finds the entry of a tag, adding it to the table the first time it is seen
+	Param: name -> the tag, in program memory
+	Returns: the index of the entry, UNTAGGED if the table is full
+*/
+static uint8_t findEntry(const char *name)
+{
+	for(uint8_t i = 1; i < entryCount; i++)
+		if(entries[i].name == name)
+			return i;
+
+	if(entryCount > I2C_PROFILE_MAX_TAGS)
+		return UNTAGGED;
+
+	entries[entryCount] = (i2c_profile_entry_t) { .name = name };
+	return entryCount++;
+}
+
+/*
+	Returns: the time in ticks of I2C_PROFILE_TICK_NS, wrapping around
+*/
+static uint32_t readClock(void)
+{
+#ifdef __AVR__
+	uint32_t overflows;
+	uint8_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = TCNT0;
+		overflows = timerOverflows;
+		// TCNT0 wrapped but the interrupt has not run yet
+		if((TIFR0 & (1 << TOV0)) && count < 128)
+			overflows++;
+	}
+
+	return (overflows << 8) | count;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint32_t) ((uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec);
+#endif
+}
+
+/*
+   charges the current tag with a bus operation
+	Param: start -> the clock when the operation started
+		   starts -> the number of START conditions sent
+		   bytes -> the number of data bytes sent or received
+*/
+static void charge(uint32_t start, uint8_t starts, uint8_t bytes)
+{
+	i2c_profile_entry_t *entry = &entries[currentTag];
+	entry->starts += starts;
+	entry->bytes += bytes;
+	entry->ticks += readClock() - start;
+}
+
+/*
+   copies a string from program memory, at most NAME_LENGTH characters
+	Param: buffer -> where to copy the string to, it is not terminated
+		   name -> the string, in program memory
+	Returns: a pointer to the character after the last copied
+*/
+static char *copyName(char *buffer, const char *name)
+{
+	for(uint8_t i = 0; i < NAME_LENGTH; i++)
+	{
+		char c = pgm_read_byte(name + i);
+		if(c == '\0')
+			break;
+		*buffer++ = c;
+	}
+
+	return buffer;
+}
+
+/*
+   writes a number in decimal, without leading zeros. Only used when dumping, so a division is
+   fine
+	Param: buffer -> where to write the digits, it is not terminated
+		   value -> the number
+	Returns: a pointer to the character after the last digit
+*/
+static char *appendNumber(char *buffer, uint32_t value)
+{
+	char digits[10];
+	uint8_t count = 0;
+	do
+	{
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while(value != 0);
+
+	while(count != 0)
+		*buffer++ = digits[--count];
+
+	return buffer;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef GUARD_I2C_PROFILE_H
+#define GUARD_I2C_PROFILE_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "i2cMaster.h"
+
+/*
+   Counts the bus traffic of every library call: the transactions, START conditions, data bytes (the address
+   bytes sent with a START are not counted) and the time spent inside the i2cMaster.h
+   functions. Compiled in only when I2C_PROFILE is defined as 1 (e.g. -DI2C_PROFILE=1 in the
+   Makefile CPPFLAGS), otherwise it costs nothing.
+
+   A file that includes this header after i2cMaster.h has its i2cStart, i2cRepeatStart,
+   i2cStartWait, i2cWrite, i2cRead, i2cReadAck, i2cReadNak, i2cStop and i2cSubmit calls
+   replaced by counting wrappers. The counts go to the tag of the outermost I2C_PROFILE_SCOPE
+   active, so a ds3231* function that calls other ds3231* functions is charged with all of
+   their traffic, and traffic outside any scope goes to "(untagged)". Time is not counted for
+   i2cSubmit, the transaction runs in the background.
+
+   On the AVR the time is measured with Timer0, which the profiler uses exclusively, in ticks of
+   8 / F_CPU (1 us at 8 MHz) and global interrupts must be enabled. On a PC the time comes from
+   the host's monotonic clock in ns
+*/
+
+#ifndef I2C_PROFILE
+#define I2C_PROFILE 0
+#endif
+
+// the most tags counted separately, the traffic of any more goes to "(untagged)"
+#ifndef I2C_PROFILE_MAX_TAGS
+#define I2C_PROFILE_MAX_TAGS 24
+#endif
+
+#ifdef __AVR__
+#define I2C_PROFILE_TICK_NS (8000000000ULL / F_CPU) // length of a time tick in ns
+#else
+#define I2C_PROFILE_TICK_NS 1ULL
+#endif
+
+// the counts of one tag
+typedef struct
+{
+	const char *name; // in program memory (PSTR), read with pgm_read_byte
+	uint16_t calls; // number of times the outermost scope was entered with this tag
+	uint16_t transactions; // STOP conditions, plus transactions queued with i2cSubmit
+	uint16_t starts; // START and repeated START conditions
+	uint32_t bytes; // data bytes written and read
+	uint32_t ticks; // time spent in the i2cMaster.h functions, I2C_PROFILE_TICK_NS each
+} i2c_profile_entry_t;
+
+#if I2C_PROFILE
+
+/*
+   charges the bus traffic until the end of the enclosing block to the tag name, which is
+   stored in program memory. Use once at the top of a function:
+
+	uint8_t ds3231GetSecond(void)
+	{
+		I2C_PROFILE_SCOPE(ds3231GetSecond);
+		...
+*/
+#define I2C_PROFILE_SCOPE(name) \
+	uint8_t i2cProfileScope __attribute__((cleanup(i2cProfileLeave), unused)) = i2cProfileEnter(PSTR(#name))
+
+#ifndef I2C_PROFILE_IMPLEMENTATION
+#define i2cStart(address) i2cProfiledStart(address)
+#define i2cRepeatStart(address) i2cProfiledRepeatStart(address)
+#define i2cStartWait(address) i2cProfiledStartWait(address)
+#define i2cWrite(data) i2cProfiledWrite(data)
+#define i2cRead(ack) i2cProfiledRead(ack)
+#define i2cReadAck() i2cProfiledReadAck()
+#define i2cReadNak() i2cProfiledReadNak()
+#define i2cStop() i2cProfiledStop()
+#define i2cSubmit(transaction) i2cProfiledSubmit(transaction)
+#endif
+
+#else
+
+#define I2C_PROFILE_SCOPE(name)
+
+#endif
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+void initI2CProfile(void);
+void i2cProfileReset(void);
+
+uint8_t i2cProfileEnter(const char *);
+void i2cProfileLeave(uint8_t *);
+
+uint8_t i2cProfileGetEntryCount(void);
+const i2c_profile_entry_t *i2cProfileGetEntry(uint8_t);
+void i2cProfileGetTotal(i2c_profile_entry_t *);
+void i2cProfileDump(void (*)(const char *));
+
+// the counting wrappers of the i2cMaster.h functions
+uint8_t i2cProfiledStart(uint8_t);
+uint8_t i2cProfiledRepeatStart(uint8_t);
+uint8_t i2cProfiledStartWait(uint8_t);
+uint8_t i2cProfiledWrite(uint8_t);
+uint8_t i2cProfiledRead(uint8_t);
+uint8_t i2cProfiledReadAck(void);
+uint8_t i2cProfiledReadNak(void);
+uint8_t i2cProfiledStop(void);
+uint8_t i2cProfiledSubmit(i2c_transaction_t *);
+
+#endif
@@ -0,0 +1,243 @@
+#include "i2cSoftware.h"
+
+#include <stddef.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+static uint8_t softwareStart(const i2c_bus_t *, uint8_t);
+static uint8_t softwareWrite(const i2c_bus_t *, uint8_t);
+static uint8_t softwareRead(const i2c_bus_t *, bool);
+static uint8_t softwareStop(const i2c_bus_t *);
+static void pullLow(const i2c_software_pin_t *);
+static void release(const i2c_software_pin_t *);
+static bool isHigh(const i2c_software_pin_t *);
+static uint8_t releaseScl(i2c_software_t *);
+static void halfPeriod(void);
+
+/*
+   sets up a bit-banged bus on the pins in lines and fills in bus, which can then be passed to
+   e.g. `initDS3231OnBus`. A slave left part way through a byte (e.g. by a reset of the AVR)
+   is freed by clocking SCL until it lets go of SDA, then a STOP is sent:
+
+	static i2c_software_t lines = { .scl = I2C_SOFTWARE_PIN(D, 6), .sda = I2C_SOFTWARE_PIN(D, 7) };
+	static i2c_bus_t softwareBus;
+	initI2CSoftware(&softwareBus, &lines);
+
+   The PORT bits of both pins are cleared and must be left alone afterwards
+	Param: bus -> filled in with the operations of the bit-banged bus
+		   lines -> the SCL and SDA pins, must stay valid while the bus is used
+	Returns: 0 if the bus is free
+			 1 if SCL or SDA is still held low
+*/
+uint8_t initI2CSoftware(i2c_bus_t *bus, i2c_software_t *lines)
+{
+	*bus = (i2c_bus_t)
+	{
+		.start = softwareStart,
+		.write = softwareWrite,
+		.read = softwareRead,
+		.stop = softwareStop,
+		.readRegisters = NULL, // made out of the operations above by i2cBus.c
+		.writeRegisters = NULL,
+		.submit = NULL,
+		.isBusy = NULL, // transactions run straight away
+		.context = lines
+	};
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*lines->scl.port &= ~lines->scl.mask;
+		*lines->sda.port &= ~lines->sda.mask;
+	}
+	release(&lines->scl);
+	release(&lines->sda);
+	halfPeriod();
+
+	for(uint8_t i = 0; i < 9 && !isHigh(&lines->sda); i++)
+	{
+		pullLow(&lines->scl);
+		halfPeriod();
+		releaseScl(lines);
+		halfPeriod();
+	}
+
+	lines->isStarted = true; // so the STOP is sent
+	softwareStop(bus);
+
+	return isHigh(&lines->scl) && isHigh(&lines->sda) ? 0 : 1;
+}
+
+/*
+   sends a START, or a repeated START if the bus is held, then the address
+	Returns: 0 if the address was acknowledged
+			 1 on a NAK, the bus being held by another master or a clock stretch timeout
+*/
+static uint8_t softwareStart(const i2c_bus_t *bus, uint8_t address)
+{
+	i2c_software_t *lines = bus->context;
+
+	if(lines->isStarted) // SDA must go high while SCL is low, then SCL high
+	{
+		release(&lines->sda);
+		halfPeriod();
+		if(releaseScl(lines) != 0)
+			return 1;
+		halfPeriod();
+	}
+	else
+		lines->error = 0;
+
+	if(!isHigh(&lines->sda))
+	{
+		lines->error = 1;
+		return 1;
+	}
+
+	// SDA falling while SCL is high
+	pullLow(&lines->sda);
+	halfPeriod();
+	pullLow(&lines->scl);
+	lines->isStarted = true;
+
+	return softwareWrite(bus, address);
+}
+
+/*
+   sends a byte, most significant bit first, and clocks in the acknowledge
+	Returns: 0 if the byte was acknowledged
+			 1 on a NAK or a clock stretch timeout
+*/
+static uint8_t softwareWrite(const i2c_bus_t *bus, uint8_t data)
+{
+	i2c_software_t *lines = bus->context;
+
+	for(uint8_t bit = 0x80; bit != 0; bit >>= 1)
+	{
+		if(data & bit)
+			release(&lines->sda);
+		else
+			pullLow(&lines->sda);
+		halfPeriod();
+		if(releaseScl(lines) != 0)
+			return 1;
+		halfPeriod();
+		pullLow(&lines->scl);
+	}
+
+	release(&lines->sda);
+	halfPeriod();
+	if(releaseScl(lines) != 0)
+		return 1;
+	bool isNak = isHigh(&lines->sda);
+	halfPeriod();
+	pullLow(&lines->scl);
+
+	return isNak ? 1 : 0;
+}
+
+/*
+   reads a byte, most significant bit first, then sends ACK or NAK
+	Param: ack -> true to ask for another byte, false before a STOP
+	Returns: the byte read, a clock stretch timeout is reported by the STOP
+*/
+static uint8_t softwareRead(const i2c_bus_t *bus, bool ack)
+{
+	i2c_software_t *lines = bus->context;
+	uint8_t data = 0;
+
+	release(&lines->sda);
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		halfPeriod();
+		if(releaseScl(lines) != 0)
+			return 0;
+		data = (data << 1) | (isHigh(&lines->sda) ? 1 : 0);
+		halfPeriod();
+		pullLow(&lines->scl);
+	}
+
+	if(ack)
+		pullLow(&lines->sda);
+	halfPeriod();
+	releaseScl(lines);
+	halfPeriod();
+	pullLow(&lines->scl);
+	release(&lines->sda);
+
+	return data;
+}
+
+/*
+   sends a STOP, SDA rising while SCL is high
+	Returns: 0 on success
+			 1 if a clock stretch timed out since the START, or SDA is held low
+*/
+static uint8_t softwareStop(const i2c_bus_t *bus)
+{
+	i2c_software_t *lines = bus->context;
+
+	pullLow(&lines->sda);
+	halfPeriod();
+	releaseScl(lines);
+	halfPeriod();
+	release(&lines->sda);
+	halfPeriod();
+
+	if(!isHigh(&lines->sda))
+		lines->error = 1;
+	lines->isStarted = false;
+
+	uint8_t error = lines->error;
+	lines->error = 0;
+
+	return error;
+}
+
+// drives the line low by making the pin an output, its PORT bit is clear
+static void pullLow(const i2c_software_pin_t *line)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*line->ddr |= line->mask;
+	}
+}
+
+// lets the pull-up take the line high by making the pin an input
+static void release(const i2c_software_pin_t *line)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		*line->ddr &= ~line->mask;
+	}
+}
+
+static bool isHigh(const i2c_software_pin_t *line)
+{
+	return (*line->pin & line->mask) != 0;
+}
+
+/*
+   releases SCL and waits for it to go high, a slave may hold it low to stretch the clock
+	Returns: 0 once SCL is high
+			 1 if it was held low for longer than I2C_SOFTWARE_STRETCH_US, recorded for the STOP
+*/
+static uint8_t releaseScl(i2c_software_t *lines)
+{
+	release(&lines->scl);
+	for(uint16_t waited = 0; !isHigh(&lines->scl); waited++)
+	{
+		if(waited >= I2C_SOFTWARE_STRETCH_US)
+		{
+			lines->error = 1;
+			return 1;
+		}
+		_delay_us(1);
+	}
+
+	return 0;
+}
+
+static void halfPeriod(void)
+{
+	_delay_us(I2C_SOFTWARE_HALF_PERIOD_US);
+}
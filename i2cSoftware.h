@@ -0,0 +1,53 @@
+#ifndef GUARD_I2C_SOFTWARE_H
+#define GUARD_I2C_SOFTWARE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+
+#include "i2cBus.h"
+
+/*
+   A bit-banged i2c master on any two AVR pins, for when the TWI pins are taken or a second bus
+   is needed. The lines are driven open drain (the pin is made an output to pull the line low
+   and an input to let it go high), so external pull-up resistors are required. Slaves may
+   stretch the clock for up to I2C_SOFTWARE_STRETCH_US. Interrupts may run at any time, they
+   only slow the bus down
+*/
+
+// half of the SCL period, 5 us gives the 100 kHz Standard-mode (a little less in practice)
+#ifndef I2C_SOFTWARE_HALF_PERIOD_US
+#define I2C_SOFTWARE_HALF_PERIOD_US 5
+#endif
+
+// the longest a slave may hold SCL low before the transfer fails
+#ifndef I2C_SOFTWARE_STRETCH_US
+#define I2C_SOFTWARE_STRETCH_US 1000
+#endif
+
+// an AVR pin, e.g. I2C_SOFTWARE_PIN(D, 6) for PD6
+typedef struct
+{
+	volatile uint8_t *ddr;
+	volatile uint8_t *port;
+	volatile uint8_t *pin;
+	uint8_t mask;
+} i2c_software_pin_t;
+
+#define I2C_SOFTWARE_PIN(letter, bit) { &DDR ## letter, &PORT ## letter, &PIN ## letter, (1 << (bit)) }
+
+// the state of one bit-banged bus
+typedef struct
+{
+	i2c_software_pin_t scl;
+	i2c_software_pin_t sda;
+	bool isStarted; // true between a START and the STOP, the next START is a repeated START
+	uint8_t error; // non zero if a transfer failed since the START, reported by the STOP
+} i2c_software_t;
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+uint8_t initI2CSoftware(i2c_bus_t *, i2c_software_t *);
+
+#endif
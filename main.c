@@ -1,15 +1,32 @@
 #include "DS3231.h"
+#include "ds3231AlarmService.h"
 #include "USART.h"
+#include "telemetry.h"
 
 #include <util/delay.h>
+#include <avr/interrupt.h>
 #include <avr/power.h>
+#include <avr/sleep.h>
+
+// runs from the main loop each time ALARM_1 triggers
+static void onAlarm1(alarm_number_t alarm)
+{
+	datetime_t now;
+	telemetryAddAlarm(alarm);
+	if(ds3231GetDateTime(&now) == DS3231_OPERATION_SUCCESS)
+		telemetryAddDateTime(&now);
+	telemetryAddTemperature(ds3231GetTemperatureHundredths());
+	telemetrySend();
+
+	// the USART clock stops in power down, wait for the last byte to be sent
+	usartFlush();
+}
 
 int main()
 {
 	clock_prescale_set(clock_div_1);
-	initUSART();
+	initUSART(BAUD);
 	initDS3231();
-	DDRB |= (0 << PB0);
 
 	ds3231Use12HourMode(false);
 /*	ds3231SetSecond(58);
@@ -33,40 +50,23 @@ int main()
 	alarm.dayDate = 28;
 	alarm.trigger = A1_EVERY_SEC;
 
-	uint8_t err = ds3231SetAlarm(&alarm);
-	if(err)
-		usartTransmitByte(err);
+	uint8_t error = ds3231SetAlarm(&alarm);
+	if(error)
+		telemetryAddAlarmError(ALARM_1, error);
+	telemetryAddStatus(getRegisterValue(DS3231_REGISTER_CONTROL), getRegisterValue(DS3231_REGISTER_STATUS));
+	telemetrySend();
 
-	while(1)
-	{
-		/*uint16_t temp = ds3231GetTemperature();
-		usartTransmitByte((uint8_t) (temp >> 8));
-		usartTransmitByte((uint8_t) temp);*/
-		usartTransmitByte(ds3231GetSecond());
-		/*usartTransmitByte(ds3231GetMinute());
-		usartTransmitByte(ds3231GetHour());
-		usartTransmitByte((uint8_t) ds3231GetDay());
-		usartTransmitByte(ds3231GetDate());
-		usartTransmitByte((uint8_t) ds3231GetMonth());
-		usartTransmitByte(ds3231GetYear());
-		usartTransmitByte(ds3231GetCentury());*/
-
-		/*ds3231ForceTemperatureUpdate();
-		_delay_ms(300);
-		temp = ds3231GetTemperature();
-		usartTransmitByte((uint8_t) (temp >> 8));
-		usartTransmitByte((uint8_t) temp);*/
+	ds3231OnAlarm(ALARM_1, onAlarm1);
+	ds3231AlarmServiceStart(); // the ds3231 INT/SQW pin is wired to PB0
+	sei();
 
+	// the USART clock stops in power down, wait for the status frame to be sent
+	usartFlush();
 
-		if(PINB & (1 << PB0))
-		{
-			continue;
-		}
-		else // pin is low (therefore ds3231 alarm triggered)
-		{
-			usartTransmitByte(65);
-			ds3231ClearAlarmFlag(ALARM_1);
-		}
+	while(1)
+	{
+		// sleep until the ds3231 pulls INT/SQW low, then run the alarm callbacks
+		ds3231AlarmServiceSleep(SLEEP_MODE_PWR_DOWN);
 	}
 
 	return 0;
@@ -0,0 +1,109 @@
+#include "sqwInterrupt.h"
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+// handlers run by the pin change interrupt, empty slots are NULL
+static sqw_handler_t handlers[SQW_MAX_HANDLERS];
+// the pin level seen by the last interrupt, used to ignore other pins sharing the pin change interrupt
+static volatile bool lastLevel = true;
+
+/*
+   sets up the INT/SQW pin as an input with its pull-up enabled (the ds3231 output is open
+   drain) and enables its pin change interrupt. Safe to call more than once, every module
+   using the pin calls it. Global interrupts must be enabled for the handlers to run
+*/
+void initSqwInterrupt(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		SQW_DDR &= ~(1 << SQW_BIT);
+		SQW_PORT |= (1 << SQW_BIT);
+		lastLevel = sqwIsHigh();
+
+		SQW_PCMSK |= (1 << SQW_PCINT);
+		PCICR |= (1 << SQW_PCIE);
+	}
+}
+
+/*
+   attaches a handler to the INT/SQW pin, it is called from the pin change interrupt on
+   every level change, so it must be short
+	Param: handler -> the function to call
+	Returns: 0 on success (or if the handler was already attached)
+			 1 if SQW_MAX_HANDLERS handlers are already attached
+*/
+uint8_t sqwAddHandler(sqw_handler_t handler)
+{
+	uint8_t freeSlot = SQW_MAX_HANDLERS;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(uint8_t i = 0; i < SQW_MAX_HANDLERS; i++)
+		{
+			if(handlers[i] == handler)
+				return 0;
+			if(handlers[i] == NULL && freeSlot == SQW_MAX_HANDLERS)
+				freeSlot = i;
+		}
+
+		if(freeSlot == SQW_MAX_HANDLERS)
+			return 1;
+
+		handlers[freeSlot] = handler;
+	}
+
+	return 0;
+}
+
+/*
+   detaches a handler from the INT/SQW pin
+	Param: handler -> the function to detach
+	Returns: 0 on success
+			 1 if the handler was not attached
+*/
+uint8_t sqwRemoveHandler(sqw_handler_t handler)
+{
+	uint8_t result = 1;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for(uint8_t i = 0; i < SQW_MAX_HANDLERS; i++)
+		{
+			if(handlers[i] == handler)
+			{
+				handlers[i] = NULL;
+				result = 0;
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+	Returns: true if the INT/SQW pin is currently high
+*/
+bool sqwIsHigh(void)
+{
+	return SQW_PIN & (1 << SQW_BIT);
+}
+
+/*
+   runs every attached handler when the INT/SQW pin changes level
+*/
+ISR(SQW_vect)
+{
+	bool level = sqwIsHigh();
+	if(level == lastLevel) // another pin of the same pin change group changed
+		return;
+	lastLevel = level;
+
+	for(uint8_t i = 0; i < SQW_MAX_HANDLERS; i++)
+	{
+		if(handlers[i] != NULL)
+			handlers[i](level);
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef GUARD_SQW_INTERRUPT_H
+#define GUARD_SQW_INTERRUPT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the pin the ds3231 INT/SQW output is wired to, it must be a pin change interrupt pin.
+// PB0 (PCINT0) by default
+#ifndef SQW_BIT
+#define SQW_DDR DDRB
+#define SQW_PORT PORTB
+#define SQW_PIN PINB
+#define SQW_BIT PB0
+#define SQW_PCMSK PCMSK0
+#define SQW_PCINT PCINT0
+#define SQW_PCIE PCIE0
+#define SQW_vect PCINT0_vect
+#endif
+
+// the most handlers that can be attached to the INT/SQW pin at the same time
+#ifndef SQW_MAX_HANDLERS
+#define SQW_MAX_HANDLERS 4
+#endif
+
+// called from the pin change interrupt every time the INT/SQW pin changes level,
+// isHigh is the new level of the pin
+typedef void (*sqw_handler_t)(bool isHigh);
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+void initSqwInterrupt(void);
+uint8_t sqwAddHandler(sqw_handler_t);
+uint8_t sqwRemoveHandler(sqw_handler_t);
+bool sqwIsHigh(void);
+
+#endif
@@ -0,0 +1,239 @@
+#include "telemetry.h"
+#include "USART.h"
+
+#include <string.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#if TELEMETRY_MAX_PAYLOAD + 5 > USART_TX_BUFFER_SIZE
+#error "TELEMETRY_MAX_PAYLOAD + 5 must not be more than USART_TX_BUFFER_SIZE"
+#endif
+
+#define TELEMETRY_RECORD_HEADER_SIZE 2 // type and length
+
+// the frame being built: the sequence number, the records and room for the crc
+static uint8_t frame[1 + TELEMETRY_MAX_PAYLOAD + 2];
+static uint8_t payloadLength = 0;
+static uint8_t sequence = 0;
+static uint16_t droppedFrames = 0;
+
+static uint8_t *putWord(uint8_t *, uint16_t);
+static uint8_t *putLong(uint8_t *, uint32_t);
+static uint8_t cobsEncode(const uint8_t *, uint8_t, uint8_t *);
+
+/*
+   adds a record to the frame being built. If the frame is too full for the record it is sent
+   first, so records can be added without checking the space left
+	Param: type -> the type of the record
+		   data -> the payload of the record
+		   length -> the number of bytes in the payload
+	Returns: true if the record was added
+			 false if the record is too long to fit in any frame
+*/
+bool telemetryAddRecord(telemetry_record_type_t type, const void *data, uint8_t length)
+{
+	if(length > TELEMETRY_MAX_PAYLOAD - TELEMETRY_RECORD_HEADER_SIZE)
+		return false;
+
+	if(payloadLength + TELEMETRY_RECORD_HEADER_SIZE + length > TELEMETRY_MAX_PAYLOAD)
+		telemetrySend();
+
+	uint8_t *record = frame + 1 + payloadLength;
+	record[0] = type;
+	record[1] = length;
+	memcpy(record + TELEMETRY_RECORD_HEADER_SIZE, data, length);
+	payloadLength += TELEMETRY_RECORD_HEADER_SIZE + length;
+
+	return true;
+}
+
+/*
+   adds a TELEMETRY_DATETIME record
+	Param: dateTime -> the date and time, e.g. from ds3231GetDateTime
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddDateTime(const datetime_t *dateTime)
+{
+	uint8_t flags = 0;
+	if(ds3231Is12HourMode())
+		flags |= TELEMETRY_DATETIME_12_HOUR;
+	if(dateTime->isPM)
+		flags |= TELEMETRY_DATETIME_PM;
+
+	uint8_t record[] =
+	{
+		dateTime->century, dateTime->year, dateTime->month, dateTime->date, dateTime->day,
+		dateTime->hour, dateTime->minute, dateTime->second, flags
+	};
+	return telemetryAddRecord(TELEMETRY_DATETIME, record, sizeof(record));
+}
+
+/*
+   adds a TELEMETRY_TEMPERATURE record
+	Param: temperature -> hundredths of a degree celcius, e.g. from ds3231GetTemperatureHundredths
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddTemperature(int16_t temperature)
+{
+	uint8_t record[2];
+	putWord(record, temperature);
+	return telemetryAddRecord(TELEMETRY_TEMPERATURE, record, sizeof(record));
+}
+
+/*
+   adds a TELEMETRY_TEMPERATURE_SUMMARY record
+	Param: summary -> the statistics from temperatureLogDrain
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddTemperatureSummary(const temperature_summary_t *summary)
+{
+	uint8_t record[20];
+	uint8_t *end = putLong(record, summary->start);
+	end = putLong(end, summary->end);
+	end = putWord(end, summary->count);
+	end = putWord(end, summary->min);
+	end = putWord(end, summary->max);
+	end = putWord(end, summary->mean);
+	putLong(end, summary->variance);
+	return telemetryAddRecord(TELEMETRY_TEMPERATURE_SUMMARY, record, sizeof(record));
+}
+
+/*
+   adds a TELEMETRY_ALARM record
+	Param: alarm -> the alarm that triggered
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddAlarm(alarm_number_t alarm)
+{
+	uint8_t record = alarm;
+	return telemetryAddRecord(TELEMETRY_ALARM, &record, 1);
+}
+
+/*
+   adds a TELEMETRY_STATUS record
+	Param: control -> the value of the ds3231 CONTROL register
+		   status -> the value of the ds3231 STATUS register
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddStatus(uint8_t control, uint8_t status)
+{
+	uint8_t record[] = { control, status };
+	return telemetryAddRecord(TELEMETRY_STATUS, record, sizeof(record));
+}
+
+/*
+   adds a TELEMETRY_ALARM_ERROR record
+	Param: alarm -> the alarm that could not be set
+		   error -> the non zero value returned by ds3231SetAlarm
+	Returns: see telemetryAddRecord
+*/
+bool telemetryAddAlarmError(alarm_number_t alarm, uint8_t error)
+{
+	uint8_t record[] = { alarm, error };
+	return telemetryAddRecord(TELEMETRY_ALARM_ERROR, record, sizeof(record));
+}
+
+/*
+   sends the frame being built, if it holds any records. The frame is queued for the USART
+   to send in the background, never waiting for room. If the USART transmit buffer is too
+   full the frame is dropped, its sequence number is still used so the reader sees the gap
+	Returns: true if the frame was queued (or there was nothing to send)
+			 false if the frame was dropped
+*/
+bool telemetrySend(void)
+{
+	if(payloadLength == 0)
+		return true;
+
+	uint8_t length = 1 + payloadLength;
+	frame[0] = sequence++;
+
+	uint16_t crc = 0xffff;
+	for(uint8_t i = 0; i < length; i++)
+		crc = _crc_xmodem_update(crc, frame[i]);
+	frame[length++] = crc >> 8;
+	frame[length++] = crc & 0xff;
+	payloadLength = 0;
+
+	uint8_t encoded[sizeof(frame) + 2]; // one COBS overhead byte and the delimiter
+	uint8_t encodedLength = cobsEncode(frame, length, encoded);
+	encoded[encodedLength++] = TELEMETRY_FRAME_DELIMITER;
+
+	if(usartTryTransmit(encoded, encodedLength))
+		return true;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		droppedFrames++;
+	}
+	return false;
+}
+
+/*
+	Returns: the number of frames dropped since the last call, because the USART transmit
+			 buffer was too full
+*/
+uint16_t telemetryGetDroppedCount(void)
+{
+	uint16_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = droppedFrames;
+		droppedFrames = 0;
+	}
+	return count;
+}
+
+/*
+   stores a 16 bit value, least significant byte first
+	Returns: the position after the value
+*/
+static uint8_t *putWord(uint8_t *destination, uint16_t value)
+{
+	destination[0] = value & 0xff;
+	destination[1] = value >> 8;
+	return destination + 2;
+}
+
+/*
+   stores a 32 bit value, least significant byte first
+	Returns: the position after the value
+*/
+static uint8_t *putLong(uint8_t *destination, uint32_t value)
+{
+	destination = putWord(destination, value & 0xffff);
+	return putWord(destination, value >> 16);
+}
+
+/*
+   consistent overhead byte stuffing. Each 0x00 byte is replaced by the distance to the next
+   one, so the encoded bytes never contain 0x00 and it can mark the end of a frame
+	Param: source -> the bytes to encode
+		   length -> the number of bytes to encode, less than 254
+		   destination -> where the encoded bytes are stored, at least length + 1 bytes
+	Returns: the number of encoded bytes
+*/
+static uint8_t cobsEncode(const uint8_t *source, uint8_t length, uint8_t *destination)
+{
+	uint8_t codeIndex = 0; // where the distance to the next 0x00 will be stored
+	uint8_t code = 1;
+	uint8_t encodedLength = 1;
+
+	for(uint8_t i = 0; i < length; i++)
+	{
+		if(source[i] == 0)
+		{
+			destination[codeIndex] = code;
+			codeIndex = encodedLength++;
+			code = 1;
+		}
+		else
+		{
+			destination[encodedLength++] = source[i];
+			code++;
+		}
+	}
+
+	destination[codeIndex] = code;
+	return encodedLength;
+}
@@ -0,0 +1,62 @@
+#ifndef GUARD_TELEMETRY_H
+#define GUARD_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "DS3231.h"
+#include "temperatureLog.h"
+
+/*
+   Telemetry is sent over the USART as frames, each holding any number of records:
+
+	frame   -> COBS(sequence, record..., crc high byte, crc low byte) 0x00
+	record  -> type, payload length, payload
+
+   Every frame ends with a 0x00 byte, and COBS removes every other 0x00 byte, so a reader can
+   always find the start of the next frame after a lost or corrupted byte. The sequence number
+   goes up by one for every frame, gaps show frames that were lost. The crc is CRC-16/CCITT-FALSE
+   (polynomial 0x1021, initial value 0xffff) of the sequence number and records. Multi-byte
+   payload values are little endian. Readers should skip records of a type they don't know
+   using the length, see DS3231_serial_reader.py
+*/
+
+// the most record bytes in a frame. A whole encoded frame (TELEMETRY_MAX_PAYLOAD + 5 bytes)
+// must fit in the USART transmit buffer
+#ifndef TELEMETRY_MAX_PAYLOAD
+#define TELEMETRY_MAX_PAYLOAD 56
+#endif
+
+#define TELEMETRY_FRAME_DELIMITER 0x00
+
+// the record types, and their payloads
+typedef enum
+{
+	TELEMETRY_DATETIME = 1, // century, year, month, date, day, hour, minute, second, flags (TELEMETRY_DATETIME_*)
+	TELEMETRY_TEMPERATURE, // int16_t hundredths of a degree celcius
+	TELEMETRY_TEMPERATURE_SUMMARY, // temperature_summary_t: uint32_t start, end, uint16_t count, int16_t min, max, mean, uint32_t variance
+	TELEMETRY_ALARM, // alarm_number_t of the alarm that triggered
+	TELEMETRY_STATUS, // the CONTROL and STATUS registers of the ds3231
+	TELEMETRY_ALARM_ERROR, // alarm_number_t of an alarm that could not be set, the error returned by ds3231SetAlarm
+	TELEMETRY_RECORD_TYPE_T_MAX
+} telemetry_record_type_t;
+
+// TELEMETRY_DATETIME flags
+#define TELEMETRY_DATETIME_12_HOUR (1 << 0) // the hour is in 12 hour mode
+#define TELEMETRY_DATETIME_PM (1 << 1) // the hour is PM, only meaningful in 12 hour mode
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+bool telemetryAddRecord(telemetry_record_type_t, const void *, uint8_t);
+bool telemetryAddDateTime(const datetime_t *);
+bool telemetryAddTemperature(int16_t);
+bool telemetryAddTemperatureSummary(const temperature_summary_t *);
+bool telemetryAddAlarm(alarm_number_t);
+bool telemetryAddStatus(uint8_t, uint8_t);
+bool telemetryAddAlarmError(alarm_number_t, uint8_t);
+
+bool telemetrySend(void);
+uint16_t telemetryGetDroppedCount(void);
+
+#endif
@@ -0,0 +1,146 @@
+#include "temperatureLog.h"
+#include "DS3231.h"
+
+// ring buffer of the most recent samples
+static temperature_sample_t samples[TEMPERATURE_LOG_CAPACITY];
+static uint8_t head = 0; // index of the oldest sample
+static uint8_t count = 0;
+
+// running statistics since the last drain. The samples are accumulated as their difference
+// from the first sample of the window, which keeps the sums small and the variance accurate
+static temperature_summary_t window;
+static int16_t reference;
+static int32_t sum;
+static uint64_t sumOfSquares;
+
+/*
+   adds a sample to the log and to the running statistics
+	Param: timestamp -> when the sample was taken, seconds since 2000-01-01 00:00:00
+		   temperature -> the temperature in hundredths of a degree celcius
+*/
+void temperatureLogAdd(uint32_t timestamp, int16_t temperature)
+{
+	uint8_t tail = (head + count) % TEMPERATURE_LOG_CAPACITY;
+	samples[tail].timestamp = timestamp;
+	samples[tail].temperature = temperature;
+
+	if(count < TEMPERATURE_LOG_CAPACITY)
+		count++;
+	else // full, the oldest sample was overwritten
+		head = (head + 1) % TEMPERATURE_LOG_CAPACITY;
+
+	if(window.count == 0)
+	{
+		window.start = timestamp;
+		window.min = temperature;
+		window.max = temperature;
+		reference = temperature;
+	}
+	if(window.count == UINT16_MAX) // the statistics are full, drain more often
+		return;
+
+	window.end = timestamp;
+	window.count++;
+	if(temperature < window.min)
+		window.min = temperature;
+	if(temperature > window.max)
+		window.max = temperature;
+
+	int32_t difference = (int32_t) temperature - reference;
+	sum += difference;
+	sumOfSquares += (uint64_t) (difference * difference);
+}
+
+/*
+   reads the time and the temperature from the ds3231 and adds them to the log. The ds3231
+   converts the temperature by itself every 64 seconds, so calling this every 64 seconds
+   (for example from a ds3231Scheduler job) logs every automatic conversion
+	Returns: DS3231_OPERATION_SUCCESS (0) on success
+			 2 if the time could not be read
+*/
+uint8_t temperatureLogSample(void)
+{
+	datetime_t now;
+	if(ds3231GetDateTime(&now) != DS3231_OPERATION_SUCCESS)
+		return 2;
+
+	temperatureLogAdd(ds3231DateTimeToSeconds(&now), ds3231GetTemperatureHundredths());
+	return DS3231_OPERATION_SUCCESS;
+}
+
+/*
+   logs the result of a forced conversion, pass it to ds3231StartTemperatureConversion as
+   the callback. The time is read from the ds3231
+	Param: temperature -> the encoded temperature, as returned by ds3231GetTemperature
+*/
+void temperatureLogOnConversion(uint16_t temperature)
+{
+	datetime_t now;
+	if(ds3231GetDateTime(&now) != DS3231_OPERATION_SUCCESS)
+		return;
+
+	temperatureLogAdd(ds3231DateTimeToSeconds(&now), ds3231TemperatureToHundredths(temperature));
+}
+
+/*
+	Returns: the number of samples in the log
+*/
+uint8_t temperatureLogCount(void)
+{
+	return count;
+}
+
+/*
+   removes the oldest sample from the log. The running statistics are not affected
+	Param: sample -> the struct the sample is stored in
+	Returns: true if a sample was removed, false if the log was empty
+*/
+bool temperatureLogPop(temperature_sample_t *sample)
+{
+	if(count == 0)
+		return false;
+
+	*sample = samples[head];
+	head = (head + 1) % TEMPERATURE_LOG_CAPACITY;
+	count--;
+
+	return true;
+}
+
+/*
+   gets the statistics of every sample added since the last drain and starts a new window.
+   Sending summaries instead of every sample keeps serial traffic to a minimum. The samples
+   themselves are left in the log
+	Param: summary -> the struct the statistics are stored in
+*/
+void temperatureLogDrain(temperature_summary_t *summary)
+{
+	*summary = window;
+
+	if(window.count != 0)
+	{
+		// mean and variance of the differences, rounded to the nearest hundredth
+		int32_t n = window.count;
+		int32_t meanDifference = (sum >= 0 ? sum + n / 2 : sum - n / 2) / n;
+		uint64_t squaredSum = (uint64_t) ((int64_t) sum * sum);
+
+		summary->mean = reference + meanDifference;
+		summary->variance = (sumOfSquares - squaredSum / n + n / 2) / n;
+	}
+
+	window.count = 0;
+	window.start = window.end = 0;
+	window.min = window.max = window.mean = 0;
+	window.variance = 0;
+	sum = 0;
+	sumOfSquares = 0;
+}
+
+/*
+   removes every sample from the log, the running statistics are not affected
+*/
+void temperatureLogClear(void)
+{
+	head = 0;
+	count = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef GUARD_TEMPERATURE_LOG_H
+#define GUARD_TEMPERATURE_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// the number of samples kept in SRAM, the oldest sample is overwritten once it is full
+#ifndef TEMPERATURE_LOG_CAPACITY
+#define TEMPERATURE_LOG_CAPACITY 32
+#endif
+
+// a single temperature reading
+typedef struct
+{
+	uint32_t timestamp; // seconds since 2000-01-01 00:00:00, see ds3231DateTimeToSeconds
+	int16_t temperature; // hundredths of a degree celcius
+} temperature_sample_t;
+
+// statistics of every sample added since the last drain, temperatures in hundredths of a degree
+typedef struct
+{
+	uint32_t start; // timestamp of the first sample
+	uint32_t end; // timestamp of the last sample
+	uint16_t count; // number of samples, 0 if there were none (the other fields are then 0)
+	int16_t min;
+	int16_t max;
+	int16_t mean;
+	uint32_t variance; // population variance in (hundredths of a degree)^2
+} temperature_summary_t;
+
+////////////////////////////////////////////////////////////////
+// Function prototypes                                        //
+////////////////////////////////////////////////////////////////
+void temperatureLogAdd(uint32_t, int16_t);
+uint8_t temperatureLogSample(void);
+void temperatureLogOnConversion(uint16_t);
+
+uint8_t temperatureLogCount(void);
+bool temperatureLogPop(temperature_sample_t *);
+void temperatureLogDrain(temperature_summary_t *);
+void temperatureLogClear(void);
+
+#endif
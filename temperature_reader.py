@@ -1,32 +1,17 @@
-# allows the reading of the LM75A temperature values via a USART / UART to USB
-# adapter
-# requires pyserial to be installed
+# prints the temperatures sent in the telemetry frames of telemetry.c via a
+# USART / UART to USB adapter
+# requires pyserial to be installed, works with python 2 and 3
 
-import serial
-import time
-import math
+from __future__ import print_function
 
-# /dev/ttyUSB0 needs to be changed to the port the USART to USB adapter
-# is plugged in to
-ser = serial.Serial("/dev/ttyUSB0", 9600) # Makefile contains baud #define
-ser.flush()
+from DS3231_serial_reader import *
 
-receivedCounter = 0
-while True:
-	msb = int(ser.read().encode('hex'), 16)
-	lsb = int(ser.read().encode('hex'), 16)
-
-
-	fraction = 0.0 # the 2 fractional places the sensor sends
-	if lsb & (1 << 7): # 0.5 bit set
-		fraction += 0.5
-	if lsb & (1 << 6): # 0.25 bit set
-		fraction += 0.25
-
-	fraction = str(fraction).split('.')[1] # don't need leading 0.xxx part
-	counterString = ("[{0:<6}] " + str(msb)).format(receivedCounter)
-	temperatureString = (".{0:<3} *C" ).format(fraction)
-
-	print counterString + temperatureString
-	receivedCounter += 1
-	ser.flush()
+if __name__ == "__main__":
+	receivedCounter = 0
+	for sequence, records, lost in readFrames(openPort()):
+		if lost:
+			print("lost {0} frame(s)".format(lost))
+		for recordType, payload in records:
+			if recordType in (TELEMETRY_TEMPERATURE, TELEMETRY_TEMPERATURE_SUMMARY):
+				print("[{0:<6}] {1}".format(receivedCounter, formatRecord(recordType, payload)))
+				receivedCounter += 1